@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "ast.h"
+#include "mem.h"
+
+#define ARENA_CHUNK (64 * 1024)
+
+// Arena chunk; nodes are carved out of data and never freed one by one
+typedef struct Chunk Chunk;
+struct Chunk {
+    Chunk *prev;
+    size_t used;
+    size_t size;
+    char data[];
+};
+
+// Each thread carves from its own chunks (--jobs parses on several);
+// retired holds the chunks of threads that have finished
+static _Thread_local Chunk *arena = NULL;
+static Chunk *retired = NULL;
+static pthread_mutex_t retired_lock = PTHREAD_MUTEX_INITIALIZER;
+
+_Thread_local Node *program = NULL;
+
+void *ast_alloc(size_t size) {
+    size = (size + 15) & ~(size_t)15;
+    if (arena == NULL || arena->used + size > arena->size) {
+        size_t cap = size > ARENA_CHUNK ? size : ARENA_CHUNK;
+        Chunk *c = mem_alloc(sizeof(Chunk) + cap);
+        c->prev = arena;
+        c->used = 0;
+        c->size = cap;
+        arena = c;
+    }
+    void *p = arena->data + arena->used;
+    arena->used += size;
+    return p;
+}
+
+char *ast_strndup(const char *s, size_t n) {
+    char *p = ast_alloc(n + 1);
+    memcpy(p, s, n);
+    p[n] = '\0';
+    return p;
+}
+
+static void free_chunks(Chunk *c) {
+    while (c != NULL) {
+        Chunk *prev = c->prev;
+        mem_free(c);
+        c = prev;
+    }
+}
+
+void ast_free(void) {
+    free_chunks(arena);
+    arena = NULL;
+    pthread_mutex_lock(&retired_lock);
+    free_chunks(retired);
+    retired = NULL;
+    pthread_mutex_unlock(&retired_lock);
+    program = NULL;
+}
+
+void ast_retire(void) {
+    if (arena == NULL) return;
+    Chunk *first = arena;
+    while (first->prev != NULL) first = first->prev;
+    pthread_mutex_lock(&retired_lock);
+    first->prev = retired;
+    retired = arena;
+    pthread_mutex_unlock(&retired_lock);
+    arena = NULL;
+}
+
+// Constructors return NULL in check mode so no tree is ever built
+Node *node(int kind, int line) {
+    if (check_only) return NULL;
+    Node *n = ast_alloc(sizeof(Node));
+    memset(n, 0, sizeof(Node));
+    n->kind = kind;
+    n->line = line;
+    n->sym = -1;
+    n->decl = -1;
+    return n;
+}
+
+Node *node_sym(int kind, int sym, int line) {
+    Node *n = node(kind, line);
+    if (n) n->sym = sym;
+    return n;
+}
+
+Node *node_op(int kind, int op, Node *a, Node *b, int line) {
+    Node *n = node(kind, line);
+    if (n) {
+        n->op = op;
+        n->a = a;
+        n->b = b;
+    }
+    return n;
+}
+
+List list_one(Node *n) {
+    List l = { n, n };
+    return l;
+}
+
+List list_add(List l, Node *n) {
+    if (n == NULL) return l;
+    if (l.head == NULL) return list_one(n);
+    l.tail->next = n;
+    l.tail = n;
+    return l;
+}
+
+List list_cat(List a, List b) {
+    if (a.head == NULL) return b;
+    if (b.head == NULL) return a;
+    a.tail->next = b.head;
+    a.tail = b.tail;
+    return a;
+}
@@ -0,0 +1,86 @@
+#ifndef AST_H
+#define AST_H
+
+#include <stddef.h>
+
+// Primitive types named by the type keywords
+enum {
+    TY_VOID, TY_INT, TY_FLOAT, TY_DOUBLE, TY_BOOL, TY_CHAR, TY_STRING
+};
+
+// Node kinds
+enum {
+    N_VAR,          // variable declaration: a = initializer, op = type
+    N_FUNC,         // function: a = params, b = body, op = return type,
+                    // v.i = parameters and variables it declares
+    N_PARAM,        // parameter, op = type
+    N_BLOCK,        // a = statements
+    N_ASSIGN,       // sym = a
+    N_INCR,         // sym++ / sym--, op = INC or DEC
+    N_PRINT,        // a = value, op = PRINT or PRINTLN
+    N_READ,         // read sym
+    N_RETURN,       // a = value (may be NULL)
+    N_IF,           // a = condition, b = then, c = else
+    N_WHILE,        // a = condition, b = body
+    N_FOR,          // a = init, b = condition, c = step, d = body
+    N_FOREACH,      // sym = a .. b, c = body
+    N_BREAK,
+    N_CONTINUE,
+    N_EXPR,         // expression statement, a = call
+    N_INT,
+    N_REAL,
+    N_STRING,
+    N_BOOL,
+    N_NAME,         // use of sym
+    N_CALL,         // sym(a...)
+    N_BINARY,       // a op b
+    N_UNARY         // op a
+};
+
+#define F_CONST 1   // flag on N_VAR: declared const
+
+typedef struct Node Node;
+struct Node {
+    unsigned char kind;
+    unsigned char flags;
+    short op;           // operator token or type
+    int line;
+    int sym;            // symbol id of the name, -1 if none
+    union {
+        int decl;       // declaration the name resolves to (scope.h), -1 if none
+        int type;       // N_BINARY, N_UNARY: type of the result (types.h)
+    };
+    Node *a, *b, *c, *d;
+    Node *next;         // next node in a list
+    union {
+        long long i;
+        double r;
+        char *s;
+    } v;
+};
+
+// A list under construction: head plus tail for O(1) append
+typedef struct {
+    Node *head;
+    Node *tail;
+} List;
+
+// Nodes and literal text live in one arena freed all at once. A thread that
+// built nodes and exits while they are still in use retires its part first.
+void *ast_alloc(size_t size);
+char *ast_strndup(const char *s, size_t n);
+void ast_free(void);
+void ast_retire(void);
+
+Node *node(int kind, int line);
+Node *node_sym(int kind, int sym, int line);
+Node *node_op(int kind, int op, Node *a, Node *b, int line);
+List list_one(Node *n);
+List list_add(List l, Node *n);
+List list_cat(List a, List b);
+
+// Top-level items of the last parse on this thread
+extern _Thread_local Node *program;
+extern int check_only;
+
+#endif
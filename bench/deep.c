@@ -0,0 +1,113 @@
+// Deep-nesting stress benchmark.
+//
+// Generates sources whose parenthesised expressions or blocks nest from 10
+// up to MAX levels (powers of ten), runs the parser on each and reports wall
+// time and peak resident memory of the parser process.
+//
+//     bench/deep [PARSER] [MAX] [PARSER ARGS...]
+//
+// PARSER defaults to ./parser, MAX to 1000000, the arguments to --check.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define PER_LINE 64     // nesting characters per source line
+
+static const char *path = "/tmp/deep_bench.sd";
+
+static void repeat(FILE *f, const char *s, long n) {
+    for (long i = 0; i < n; i++) {
+        fputs(s, f);
+        if (i % PER_LINE == PER_LINE - 1) fputc('\n', f);
+    }
+    fputc('\n', f);
+}
+
+// x = (((...1...)));
+static void gen_parens(FILE *f, long depth) {
+    fputs("int main() {\n    int x;\n    x =\n", f);
+    repeat(f, "(", depth);
+    fputs("1\n", f);
+    repeat(f, ")", depth);
+    fputs(";\n    println x;\n}\n", f);
+}
+
+// { { ... println 1; ... } }
+static void gen_blocks(FILE *f, long depth) {
+    fputs("void main() {\n", f);
+    repeat(f, "{", depth);
+    fputs("println 1;\n", f);
+    repeat(f, "}", depth);
+    fputs("}\n", f);
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// Run the parser on path; returns its exit status, -1 if it did not exit
+static int run(char **argv, double *ms, long *peak_kb) {
+    fflush(stdout);
+    double t0 = now_ms();
+    pid_t pid = fork();
+    if (pid == 0) {
+        freopen("/dev/null", "w", stdout);
+        freopen("/dev/null", "w", stderr);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    int status;
+    struct rusage ru;
+    wait4(pid, &status, 0, &ru);
+    *ms = now_ms() - t0;
+    *peak_kb = ru.ru_maxrss;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int main(int argc, char **argv) {
+    char *parser = argc > 1 ? argv[1] : "./parser";
+    long max = argc > 2 ? atol(argv[2]) : 1000000;
+    char *args[argc + 3];
+    int n = 0;
+    args[n++] = parser;
+    for (int i = 3; i < argc; i++) args[n++] = argv[i];
+    if (argc <= 3) args[n++] = "--check";
+    args[n++] = (char *)path;
+    args[n] = NULL;
+
+    struct {
+        const char *name;
+        void (*gen)(FILE *, long);
+    } kinds[] = { { "parens", gen_parens }, { "blocks", gen_blocks } };
+
+    printf("%-8s %10s %12s %12s %12s %s\n", "kind", "depth", "bytes", "time_ms",
+           "peak_kb", "status");
+    int failed = 0;
+    for (int k = 0; k < 2; k++) {
+        for (long depth = 10; depth <= max; depth *= 10) {
+            FILE *f = fopen(path, "w");
+            if (!f) {
+                perror(path);
+                return 1;
+            }
+            kinds[k].gen(f, depth);
+            long bytes = ftell(f);
+            fclose(f);
+            double ms;
+            long peak_kb;
+            int status = run(args, &ms, &peak_kb);
+            printf("%-8s %10ld %12ld %12.2f %12ld %s\n", kinds[k].name, depth, bytes, ms,
+                   peak_kb, status == 0 ? "ok" : "FAILED");
+            failed |= status != 0;
+        }
+    }
+    unlink(path);
+    return failed;
+}
@@ -0,0 +1,378 @@
+// Synthetic .sd corpus generator.
+//
+// Writes a valid program of roughly SIZE bytes to stdout: global variable
+// and constant declarations, then functions that only call functions
+// defined before them, then main(). The output depends only on the options,
+// so a seed names a corpus.
+//
+//     bench/gen [options] > corpus.sd
+//
+//     --seed N        random seed (1)
+//     --size N[KMG]   target size in bytes (1M)
+//     --idents N      distinct global variable names (1000)
+//     --comments P    chance of a comment before a statement (0.1)
+//     --depth N       maximum expression depth (4)
+//     --strings P     share of print statements printing a string literal (0.3)
+//     --mix K=W,...   statement weights for assign, if, while, for, foreach,
+//                     print and call (assign=6,if=2,while=1,for=1,foreach=1,
+//                     print=2,call=2)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#define MAX_NEST 3      // statement nesting inside a function body
+#define NCONSTS 8
+#define NREALS 4
+
+enum { S_ASSIGN, S_IF, S_WHILE, S_FOR, S_FOREACH, S_PRINT, S_CALL, NSTMTS };
+
+static const char *stmt_names[NSTMTS] = {
+    "assign", "if", "while", "for", "foreach", "print", "call"
+};
+
+static const char *words[] = {
+    "count", "total", "index", "value", "sum", "tmp", "result", "item",
+    "size", "len", "acc", "next", "prev", "max", "min", "step"
+};
+#define NWORDS (int)(sizeof(words) / sizeof(words[0]))
+
+// Options
+static unsigned long long seed = 1;
+static long long size = 1 << 20;
+static int idents = 1000;
+static double comments = 0.1;
+static int depth = 4;
+static double strings = 0.3;
+static int mix[NSTMTS] = { 6, 2, 1, 1, 1, 2, 2 };
+
+static long long written = 0;
+static int cur_func = 0;            // functions defined so far
+static int *arity = NULL;
+static int arity_cap = 0;
+
+// splitmix64: small, fast and the same on every platform
+static unsigned long long next_random(void) {
+    unsigned long long z = (seed += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static int rnd(int n) {
+    return (int)(next_random() % (unsigned long long)n);
+}
+
+static int chance(double p) {
+    return (next_random() >> 11) * (1.0 / 9007199254740992.0) < p;
+}
+
+static void emit(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    written += vprintf(fmt, ap);
+    va_end(ap);
+}
+
+static void indent(int level) {
+    emit("%*s", 4 * level, "");
+}
+
+static void global_name(int i) {
+    if (i < NWORDS) emit("%s", words[i]);
+    else emit("%s%d", words[i % NWORDS], i / NWORDS);
+}
+
+static void comment(int level) {
+    if (!chance(comments)) return;
+    indent(level);
+    if (chance(0.8)) {
+        emit("// %s %s\n", words[rnd(NWORDS)], words[rnd(NWORDS)]);
+    } else {
+        emit("/* %s\n", words[rnd(NWORDS)]);
+        indent(level);
+        emit(" * %s %s */\n", words[rnd(NWORDS)], words[rnd(NWORDS)]);
+    }
+}
+
+// An int operand: literal, global, constant, parameter or local
+static void atom(int params) {
+    switch (rnd(5)) {
+    case 0: emit("%d", rnd(100)); break;
+    case 1: global_name(rnd(idents)); break;
+    case 2: emit("k%d", rnd(NCONSTS)); break;
+    case 3:
+        if (params > 0) {
+            emit("%c", 'a' + rnd(params));
+            break;
+        }
+        // fall through
+    default: emit("%c", "tu"[rnd(2)]); break;
+    }
+}
+
+static void expr(int d, int params);
+
+static void call(int d, int params) {
+    int f = rnd(cur_func);
+    emit("fn%d(", f);
+    for (int i = 0; i < arity[f]; i++) {
+        if (i > 0) emit(", ");
+        expr(d - 1, params);
+    }
+    emit(")");
+}
+
+// An int expression at most d levels deep
+static void expr(int d, int params) {
+    if (d <= 1 || chance(0.3)) {
+        atom(params);
+        return;
+    }
+    switch (rnd(6)) {
+    case 0:
+        emit("(");
+        expr(d - 1, params);
+        emit(")");
+        break;
+    case 1:
+        emit("-");
+        atom(params);
+        break;
+    case 2:
+        if (cur_func > 0) {
+            call(d, params);
+            break;
+        }
+        // fall through
+    case 3:
+        // Division only by a non-zero literal
+        expr(d - 1, params);
+        emit(" %c %d", "/%"[rnd(2)], 1 + rnd(9));
+        break;
+    default:
+        expr(d - 1, params);
+        emit(" %c ", "+-*"[rnd(3)]);
+        expr(d - 1, params);
+        break;
+    }
+}
+
+static void cond(int params) {
+    static const char *rel[] = { "<", ">", "<=", ">=", "==", "!=" };
+    if (chance(0.1)) emit("!");
+    emit("(");
+    expr(depth, params);
+    emit(" %s ", rel[rnd(6)]);
+    expr(depth, params);
+    emit(")");
+    if (chance(0.2)) {
+        emit(" %s ", chance(0.5) ? "&&" : "||");
+        cond(params);
+    }
+}
+
+static void string_literal(void) {
+    emit("\"%s %s", words[rnd(NWORDS)], words[rnd(NWORDS)]);
+    if (chance(0.1)) emit(" \"\"%s\"\"", words[rnd(NWORDS)]);
+    emit(": \"");
+}
+
+static int pick_stmt(int level) {
+    int total = 0;
+    for (int i = 0; i < NSTMTS; i++) total += mix[i];
+    for (;;) {
+        int r = rnd(total), s = 0;
+        while (r >= mix[s]) r -= mix[s++];
+        if (s == S_CALL && cur_func == 0) continue;
+        // Compound statements only while there is nesting left
+        if (level > MAX_NEST && s >= S_IF && s <= S_FOREACH) continue;
+        return s;
+    }
+}
+
+static void stmt(int s, int level, int params);
+
+// Loop and branch bodies: one statement, or a block of a few. A while loop
+// takes two statements, its counter reset and the loop, so it needs a block.
+static void body(int level, int params, const char *counter) {
+    int s = pick_stmt(level + 1);
+    if (counter == NULL && s != S_WHILE && chance(0.3)) {
+        emit("\n");
+        stmt(s, level + 1, params);
+        return;
+    }
+    emit(" {\n");
+    stmt(s, level + 1, params);
+    for (int n = rnd(3); n > 0; n--) stmt(pick_stmt(level + 1), level + 1, params);
+    if (counter) {
+        indent(level + 1);
+        emit("%s++;\n", counter);
+    }
+    indent(level);
+    emit("}\n");
+}
+
+static void stmt(int s, int level, int params) {
+    // Each nesting level has its own loop counter
+    char counter[] = { 'i', '0' + level - 1, '\0' };
+    comment(level);
+    indent(level);
+    switch (s) {
+    case S_ASSIGN:
+        if (chance(0.1)) {
+            emit("r%d = r%d * %d.%d + %d.5;\n", rnd(NREALS), rnd(NREALS), rnd(10),
+                 rnd(100), rnd(10));
+            break;
+        }
+        if (chance(0.5)) global_name(rnd(idents));
+        else emit("%c", "tu"[rnd(2)]);
+        emit(" = ");
+        expr(depth, params);
+        emit(";\n");
+        break;
+    case S_IF:
+        emit("if (");
+        cond(params);
+        emit(")");
+        body(level, params, NULL);
+        if (chance(0.4)) {
+            indent(level);
+            emit("else");
+            body(level, params, NULL);
+        }
+        break;
+    case S_WHILE:
+        emit("%s = 0;\n", counter);
+        indent(level);
+        emit("while (%s < %d)", counter, 1 + rnd(4));
+        body(level, params, counter);
+        break;
+    case S_FOR:
+        emit("for (%s = 0; %s < %d; %s++)", counter, counter, 1 + rnd(4), counter);
+        body(level, params, NULL);
+        break;
+    case S_FOREACH:
+        emit("foreach (%s : 1 .. %d)", counter, 1 + rnd(4));
+        body(level, params, NULL);
+        break;
+    case S_PRINT:
+        emit(chance(0.5) ? "println " : "print ");
+        if (chance(strings)) string_literal();
+        else expr(depth, params);
+        emit(";\n");
+        break;
+    case S_CALL:
+        call(depth, params);
+        emit(";\n");
+        break;
+    }
+}
+
+static void function(void) {
+    int params = rnd(4);
+    if (cur_func == arity_cap) {
+        arity_cap = arity_cap ? arity_cap * 2 : 1024;
+        arity = realloc(arity, arity_cap * sizeof(int));
+    }
+    emit("\n");
+    comment(0);
+    emit("int fn%d(", cur_func);
+    for (int i = 0; i < params; i++) emit("%sint %c", i ? ", " : "", 'a' + i);
+    emit(") {\n");
+    indent(1);
+    emit("int t, u");
+    for (int i = 0; i < MAX_NEST; i++) emit(", i%d", i);
+    emit(";\n");
+    indent(1);
+    emit("t = %d;\n", rnd(10));
+    indent(1);
+    emit("u = %d;\n", rnd(10));
+    for (int n = 3 + rnd(10); n > 0; n--) stmt(pick_stmt(1), 1, params);
+    indent(1);
+    emit("return ");
+    expr(depth, params);
+    emit(";\n}\n");
+    arity[cur_func++] = params;
+}
+
+static void globals(void) {
+    emit("// generated by bench/gen\n\n");
+    for (int i = 0; i < NCONSTS; i++) emit("const int k%d = %d;\n", i, 1 + rnd(20));
+    emit("double r0");
+    for (int i = 1; i < NREALS; i++) emit(", r%d", i);
+    emit(";\n");
+    for (int i = 0; i < idents; i++) {
+        emit(i % 8 == 0 ? "int " : ", ");
+        global_name(i);
+        if (i % 8 == 7 || i == idents - 1) emit(";\n");
+    }
+}
+
+static void main_function(void) {
+    emit("\nmain()\n{\n");
+    int first = cur_func > 8 ? cur_func - 8 : 0;
+    for (int f = first; f < cur_func; f++) {
+        indent(1);
+        emit("println fn%d(", f);
+        for (int i = 0; i < arity[f]; i++) emit("%s%d", i ? ", " : "", rnd(10));
+        emit(");\n");
+    }
+    emit("}\n");
+}
+
+static long long parse_size(const char *s) {
+    char *end;
+    long long n = strtoll(s, &end, 10);
+    switch (*end) {
+    case 'k': case 'K': return n << 10;
+    case 'm': case 'M': return n << 20;
+    case 'g': case 'G': return n << 30;
+    }
+    return n;
+}
+
+// "assign=6,if=2,..."; names not given keep their weight
+static int parse_mix(char *s) {
+    for (char *tok = strtok(s, ","); tok; tok = strtok(NULL, ",")) {
+        char *eq = strchr(tok, '=');
+        int i = 0;
+        if (eq == NULL) return 0;
+        *eq = '\0';
+        while (i < NSTMTS && strcmp(stmt_names[i], tok) != 0) i++;
+        if (i == NSTMTS) return 0;
+        mix[i] = atoi(eq + 1);
+    }
+    return mix[S_ASSIGN] + mix[S_PRINT] > 0;
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *opt = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        int ok = val != NULL;
+        if (ok && strcmp(opt, "--seed") == 0) seed = strtoull(val, NULL, 10);
+        else if (ok && strcmp(opt, "--size") == 0) size = parse_size(val);
+        else if (ok && strcmp(opt, "--idents") == 0) idents = atoi(val);
+        else if (ok && strcmp(opt, "--comments") == 0) comments = atof(val);
+        else if (ok && strcmp(opt, "--depth") == 0) depth = atoi(val);
+        else if (ok && strcmp(opt, "--strings") == 0) strings = atof(val);
+        else if (ok && strcmp(opt, "--mix") == 0) ok = parse_mix(argv[i + 1]);
+        else ok = 0;
+        if (!ok || idents < 1 || depth < 1) {
+            fprintf(stderr, "Usage: %s [--seed N] [--size N[KMG]] [--idents N] "
+                    "[--comments P]\n          [--depth N] [--strings P] [--mix K=W,...]\n",
+                    argv[0]);
+            return 1;
+        }
+        i++;
+    }
+
+    static char out[1 << 20];
+    setvbuf(stdout, out, _IOFBF, sizeof(out));
+    globals();
+    do function(); while (written < size);
+    main_function();
+    return 0;
+}
@@ -0,0 +1,272 @@
+// Microbenchmarks for the scanner's hot routines.
+//
+// Times hash(), lookup() (hits and misses), insert() (existing and new
+// names), one scan() call per token class and the listing of comment text
+// (LIST), each over parameterized inputs: identifier length, symbol table
+// fill ratio, token class and line length. Every case runs WARMUP untimed
+// batches, then REPS timed batches of a fixed number of operations, and
+// reports ns per operation as median, p99, mean and a 95% confidence
+// interval of the mean.
+//
+//     bench/micro [--reps N] [--warmup N] [--filter TEXT]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ast.h"
+#include "y.tab.h"
+#include "token.h"
+
+// The scanner's symbol table and line buffer
+unsigned int hash(char *s);
+void create();
+int lookup(char *s);
+int insert(char *s);
+extern int nsymbols;
+extern char buf[];
+extern int listing;
+int scan(void);
+
+// Parser globals the scanner and arena refer to
+int check_only = 0;
+int errors = 0;
+
+#define OPS 100000          // operations per timed batch
+#define SLOTS 211           // initial symbol table size, see scanner.l
+
+static int reps = 31, warmup = 3;
+static const char *filter = NULL;
+static volatile unsigned long sink;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int by_value(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Run fn(ops) warmup times, then reps timed times; print ns per operation
+static void measure(const char *name, void (*fn)(int), int ops) {
+    if (filter && strstr(name, filter) == NULL) return;
+    double *ns = malloc(reps * sizeof(double));
+    for (int i = 0; i < warmup; i++) fn(ops);
+    for (int i = 0; i < reps; i++) {
+        double t0 = now_ns();
+        fn(ops);
+        ns[i] = (now_ns() - t0) / ops;
+    }
+    qsort(ns, reps, sizeof(double), by_value);
+    double mean = 0, var = 0;
+    for (int i = 0; i < reps; i++) mean += ns[i];
+    mean /= reps;
+    for (int i = 0; i < reps; i++) var += (ns[i] - mean) * (ns[i] - mean);
+    double ci = reps > 1 ? 1.96 * sqrt(var / (reps - 1)) / sqrt(reps) : 0;
+    int p99 = (int)ceil(0.99 * reps) - 1;
+    printf("%-28s %9.2f %9.2f %9.2f %9.2f\n", name, ns[reps / 2], ns[p99], mean, ci);
+    free(ns);
+}
+
+// ---- symbol table ---------------------------------------------------------
+
+#define NNAMES 4096
+
+static char *names[NNAMES];     // names in the table
+static char *absent[NNAMES];    // names never inserted
+static int nnames;
+
+// Distinct identifiers of exactly len characters: tag, filler, then i in
+// base 62 at the end
+static char *make_name(int i, int len, char tag) {
+    static const char digits[] =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    char *s = malloc(len + 1);
+    for (int k = 0; k < len; k++) s[k] = 'a' + (k * 13) % 26;
+    s[0] = tag;
+    for (int k = len - 1, v = i; k > 0 && v > 0; k--, v /= 62) s[k] = digits[v % 62];
+    s[len] = '\0';
+    return s;
+}
+
+// A table of SLOTS slots holding fill * SLOTS names of length len
+static void fill_table(int len, double fill) {
+    for (int i = 0; i < nnames; i++) free(names[i]), free(absent[i]);
+    create();
+    nnames = (int)(fill * SLOTS);
+    for (int i = 0; i < nnames; i++) {
+        names[i] = make_name(i, len, 'n');
+        absent[i] = make_name(i, len, 'z');
+        insert(names[i]);
+    }
+}
+
+static void bench_hash(int ops) {
+    unsigned long h = 0;
+    for (int i = 0; i < ops; i++) h += hash(names[i % nnames]);
+    sink = h;
+}
+
+static void bench_lookup_hit(int ops) {
+    unsigned long h = 0;
+    for (int i = 0; i < ops; i++) h += lookup(names[i % nnames]);
+    sink = h;
+}
+
+static void bench_lookup_miss(int ops) {
+    unsigned long h = 0;
+    for (int i = 0; i < ops; i++) h += lookup(absent[i % nnames]);
+    sink = h;
+}
+
+// What every ID token does after the first sighting of its name
+static void bench_insert_existing(int ops) {
+    unsigned long h = 0;
+    for (int i = 0; i < ops; i++) h += insert(names[i % nnames]);
+    sink = h;
+}
+
+// Fresh names into an empty table, growth included
+static char **fresh;
+
+static void bench_insert_new(int ops) {
+    create();
+    for (int i = 0; i < ops; i++) insert(fresh[i]);
+    sink = nsymbols;
+}
+
+// ---- scanner --------------------------------------------------------------
+
+static char *text;
+static size_t text_len;
+
+// ops copies of sample separated by spaces, scanned one token at a time;
+// comments come back as TRIVIA tokens
+static void set_text(const char *sample, int ops) {
+    size_t n = strlen(sample);
+    free(text);
+    text_len = (n + 1) * ops;
+    text = malloc(text_len + 2);
+    for (int i = 0; i < ops; i++) {
+        memcpy(text + i * (n + 1), sample, n);
+        text[i * (n + 1) + n] = sample[n - 1] == '\n' ? '\n' : ' ';
+    }
+    text[text_len] = text[text_len + 1] = '\0';
+}
+
+static void bench_scan(int ops) {
+    unsigned long k = 0;
+    scan_begin(text, text_len, SCAN_INITIAL, 1);
+    for (int i = 0; i < ops; i++) k += scan();
+    sink = k;
+}
+
+// ---- LIST -----------------------------------------------------------------
+
+static int line_len;
+static int null_fd, stdout_fd;
+
+// A comment of ops characters in lines of line_len
+static void set_comment(int ops) {
+    size_t n = 0;
+    free(text);
+    text = malloc(ops + ops / line_len + 6);
+    text[n++] = '/';
+    text[n++] = '*';
+    for (int i = 0; i < ops; i++) {
+        text[n++] = 'x';
+        if ((i + 1) % line_len == 0) text[n++] = '\n';
+    }
+    text[n++] = '*';
+    text[n++] = '/';
+    text_len = n;
+    text[n] = text[n + 1] = '\0';
+}
+
+// The scanner with listing on: every comment character goes through LIST,
+// which appends it to the line with strcat, and every line end prints the
+// line. The listing goes to /dev/null.
+static void bench_list(int ops) {
+    unsigned long k = 0;
+    (void)ops;
+    fflush(stdout);
+    dup2(null_fd, STDOUT_FILENO);
+    scan_begin(text, text_len, SCAN_INITIAL, 1);
+    while (scan()) k++;
+    fflush(stdout);
+    dup2(stdout_fd, STDOUT_FILENO);
+    sink = k;
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) reps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) warmup = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++i];
+        else {
+            fprintf(stderr, "Usage: %s [--reps N] [--warmup N] [--filter TEXT]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (reps < 1) reps = 1;
+
+    printf("%-28s %9s %9s %9s %9s\n", "ns/op", "median", "p99", "mean", "ci95");
+    char name[64];
+    int lens[] = { 4, 16, 64 };
+    double fills[] = { 0.1, 0.3, 0.49 };
+    for (int l = 0; l < 3; l++) {
+        for (int f = 0; f < 3; f++) {
+            fill_table(lens[l], fills[f]);
+            snprintf(name, sizeof(name), "hash len=%d", lens[l]);
+            if (f == 0) measure(name, bench_hash, OPS);
+            snprintf(name, sizeof(name), "lookup hit len=%d fill=%.2f", lens[l], fills[f]);
+            measure(name, bench_lookup_hit, OPS);
+            snprintf(name, sizeof(name), "lookup miss len=%d fill=%.2f", lens[l], fills[f]);
+            measure(name, bench_lookup_miss, OPS);
+            snprintf(name, sizeof(name), "insert old len=%d fill=%.2f", lens[l], fills[f]);
+            measure(name, bench_insert_existing, OPS);
+        }
+        fresh = malloc(OPS * sizeof(char *));
+        for (int i = 0; i < OPS; i++) fresh[i] = make_name(i, lens[l], 'f');
+        snprintf(name, sizeof(name), "insert new len=%d", lens[l]);
+        measure(name, bench_insert_new, OPS);
+        for (int i = 0; i < OPS; i++) free(fresh[i]);
+        free(fresh);
+    }
+
+    // One sample per token class; the ID sample is already in the table
+    listing = 0;
+    struct {
+        const char *cls, *sample;
+    } tokens[] = {
+        { "ID", "counter" }, { "KEYWORD", "while" }, { "TYPE", "int" },
+        { "INT", "12345" }, { "REAL", "3.14e+2" }, { "STRING", "\"hello, world\"" },
+        { "OP", "<=" }, { "DELIM", ";" }, { "COMMENT", "// note\n" },
+    };
+    for (int t = 0; t < (int)(sizeof(tokens) / sizeof(tokens[0])); t++) {
+        set_text(tokens[t].sample, OPS);
+        snprintf(name, sizeof(name), "scan %s", tokens[t].cls);
+        measure(name, bench_scan, OPS);
+        ast_free();
+    }
+
+    listing = 1;
+    buf[0] = '\0';
+    null_fd = open("/dev/null", O_WRONLY);
+    stdout_fd = dup(STDOUT_FILENO);
+    int line_lens[] = { 16, 64, 200 };
+    for (int l = 0; l < 3; l++) {
+        line_len = line_lens[l];
+        set_comment(OPS);
+        snprintf(name, sizeof(name), "LIST line=%d", line_len);
+        measure(name, bench_list, OPS);
+    }
+    return 0;
+}
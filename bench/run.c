@@ -0,0 +1,289 @@
+// Front-end throughput benchmark.
+//
+// Runs the parser over one corpus in three modes:
+//
+//     scan    --scan-only   scanner alone
+//     parse   --check       scanner and parser, no tree
+//     full    --quiet       the whole pipeline, nothing echoed
+//
+// Each mode runs RUNS times; the fastest run counts. Results go to OUT, one
+// "mode metric value" line per metric (bytes, tokens, mb_s, tokens_s,
+// ns_token, peak_kb). Given a baseline in the same format, any metric that
+// is worse by more than THRESHOLD percent fails the run.
+//
+// With --counters each run is also measured with perf_event_open: cycles,
+// instructions, branch misses and L1D/LLC read misses, user space only,
+// reported as IPC and events per token (ipc, cycles_token, insns_token,
+// br_miss_token, l1d_miss_token, llc_miss_token). The scan mode is the
+// scanner loop of lex.yy.c alone; parse adds the yacc loop of y.tab.c, so
+// the "parse-scan" rows printed after the table are the parser's share.
+// Counters the kernel or CPU will not provide are left out.
+//
+//     bench/run [--parser P] [--corpus F] [--runs N] [--out FILE]
+//               [--baseline FILE] [--threshold PCT] [--counters]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#define NMODES 3
+#define NMETRICS 12
+
+static const char *modes[NMODES] = { "scan", "parse", "full" };
+static const char *flags[NMODES] = { "--scan-only", "--check", "--quiet" };
+
+// Higher is better for throughput and IPC, lower for time, memory and
+// events; size metrics only describe the corpus. A negative value means
+// not measured.
+enum {
+    M_BYTES, M_TOKENS, M_MB_S, M_TOKENS_S, M_NS_TOKEN, M_PEAK_KB,
+    M_IPC, M_CYCLES_TOKEN, M_INSNS_TOKEN, M_BR_MISS_TOKEN, M_L1D_MISS_TOKEN, M_LLC_MISS_TOKEN
+};
+static const char *metrics[NMETRICS] = {
+    "bytes", "tokens", "mb_s", "tokens_s", "ns_token", "peak_kb",
+    "ipc", "cycles_token", "insns_token", "br_miss_token", "l1d_miss_token", "llc_miss_token"
+};
+static const int better[NMETRICS] = { 0, 0, 1, 1, -1, -1, 1, -1, -1, -1, -1, -1 };
+
+// Hardware events for --counters
+enum { E_CYCLES, E_INSNS, E_BR_MISS, E_L1D_MISS, E_LLC_MISS, NEVENTS };
+static const struct {
+    unsigned type;
+    unsigned long long config;
+} events[NEVENTS] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                          PERF_COUNT_HW_CACHE_RESULT_MISS << 16 },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                          PERF_COUNT_HW_CACHE_RESULT_MISS << 16 },
+};
+
+static int counters = 0;
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Count ev in pid from its next exec on; -1 if the kernel refuses
+static int open_counter(int ev, pid_t pid) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events[ev].type;
+    attr.config = events[ev].config;
+    attr.disabled = 1;
+    attr.enable_on_exec = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+// Counter value scaled up for the time it was multiplexed out; -1 if unread
+static double read_counter(int fd) {
+    unsigned long long v[3];
+    if (fd < 0 || read(fd, v, sizeof(v)) != sizeof(v) || v[2] == 0) return -1;
+    return (double)v[0] * v[1] / v[2];
+}
+
+// Run argv with its stdout read into out, or discarded if out is NULL;
+// returns the exit status, -1 if it did not exit. With count non-NULL the
+// child waits until its counters are open, and count gets each event's
+// total, -1 for events that could not be counted.
+static int run(char **argv, char *out, int out_len, double *secs, long *peak_kb,
+               double count[NEVENTS]) {
+    int fd[2], go[2], ctr[NEVENTS];
+    if (out && pipe(fd) != 0) return -1;
+    if (count && pipe(go) != 0) return -1;
+    fflush(stdout);
+    double t0 = now_s();
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (count) {
+            char c;
+            close(go[1]);
+            if (read(go[0], &c, 1) != 1) _exit(127);
+        }
+        if (out) {
+            close(fd[0]);
+            dup2(fd[1], 1);
+        } else {
+            freopen("/dev/null", "w", stdout);
+        }
+        freopen("/dev/null", "w", stderr);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    if (count) {
+        for (int e = 0; e < NEVENTS; e++) ctr[e] = open_counter(e, pid);
+        if (ctr[E_CYCLES] < 0) {
+            fprintf(stderr, "perf_event_open: %s; counters off\n", strerror(errno));
+            counters = 0;
+        }
+        close(go[0]);
+        if (write(go[1], "x", 1) != 1) perror("write");
+        close(go[1]);
+    }
+    if (out) {
+        int n = 0, r;
+        close(fd[1]);
+        while (n < out_len - 1 && (r = read(fd[0], out + n, out_len - 1 - n)) > 0) n += r;
+        out[n] = '\0';
+        close(fd[0]);
+    }
+    int status;
+    struct rusage ru;
+    wait4(pid, &status, 0, &ru);
+    *secs = now_s() - t0;
+    *peak_kb = ru.ru_maxrss;
+    for (int e = 0; count && e < NEVENTS; e++) {
+        count[e] = read_counter(ctr[e]);
+        if (ctr[e] >= 0) close(ctr[e]);
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// Read "mode metric value" lines; returns 0 if the file cannot be opened
+static int load(const char *path, double v[NMODES][NMETRICS]) {
+    FILE *f = fopen(path, "r");
+    char line[256], mode[32], metric[32];
+    double value;
+    if (!f) return 0;
+    for (int m = 0; m < NMODES; m++)
+        for (int k = 0; k < NMETRICS; k++) v[m][k] = -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || sscanf(line, "%31s %31s %lf", mode, metric, &value) != 3)
+            continue;
+        for (int m = 0; m < NMODES; m++)
+            for (int k = 0; k < NMETRICS; k++)
+                if (strcmp(mode, modes[m]) == 0 && strcmp(metric, metrics[k]) == 0)
+                    v[m][k] = value;
+    }
+    fclose(f);
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    char *parser = "./parser", *corpus = "bench/corpus.sd";
+    const char *out_path = "bench/results.txt", *base_path = NULL;
+    int runs = 5;
+    double threshold = 10;
+    for (int i = 1; i < argc; i++) {
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (val && strcmp(argv[i], "--parser") == 0) parser = argv[++i];
+        else if (val && strcmp(argv[i], "--corpus") == 0) corpus = argv[++i];
+        else if (val && strcmp(argv[i], "--runs") == 0) runs = atoi(argv[++i]);
+        else if (val && strcmp(argv[i], "--out") == 0) out_path = argv[++i];
+        else if (val && strcmp(argv[i], "--baseline") == 0) base_path = argv[++i];
+        else if (val && strcmp(argv[i], "--threshold") == 0) threshold = atof(argv[++i]);
+        else if (strcmp(argv[i], "--counters") == 0) counters = 1;
+        else {
+            fprintf(stderr, "Usage: %s [--parser P] [--corpus F] [--runs N] [--out FILE]\n"
+                    "          [--baseline FILE] [--threshold PCT] [--counters]\n", argv[0]);
+            return 1;
+        }
+    }
+    struct stat st;
+    if (stat(corpus, &st) != 0) {
+        perror(corpus);
+        return 1;
+    }
+
+    double v[NMODES][NMETRICS];
+    double tokens = 0;
+    double events_best[NMODES][NEVENTS];
+    for (int m = 0; m < NMODES; m++) {
+        char *args[] = { parser, (char *)flags[m], corpus, NULL };
+        char out[256];
+        double best = 0, count[NEVENTS];
+        long best_kb = 0;
+        for (int r = 0; r < (runs > 0 ? runs : 1); r++) {
+            double secs;
+            long peak_kb;
+            if (run(args, m == 0 ? out : NULL, sizeof(out), &secs, &peak_kb,
+                    counters ? count : NULL) != 0) {
+                fprintf(stderr, "%s %s %s failed\n", parser, flags[m], corpus);
+                return 1;
+            }
+            // Counters come from the fastest run, like the times
+            if (r == 0 || secs < best) {
+                best = secs;
+                if (counters) memcpy(events_best[m], count, sizeof(count));
+            }
+            if (r == 0 || peak_kb < best_kb) best_kb = peak_kb;
+        }
+        if (m == 0) tokens = atof(out);
+        v[m][M_BYTES] = st.st_size;
+        v[m][M_TOKENS] = tokens;
+        v[m][M_MB_S] = st.st_size / best / 1e6;
+        v[m][M_TOKENS_S] = tokens / best;
+        v[m][M_NS_TOKEN] = best * 1e9 / tokens;
+        v[m][M_PEAK_KB] = best_kb;
+        for (int k = M_IPC; k < NMETRICS; k++) v[m][k] = -1;
+        if (counters) {
+            double *c = events_best[m];
+            if (c[E_CYCLES] > 0 && c[E_INSNS] >= 0) v[m][M_IPC] = c[E_INSNS] / c[E_CYCLES];
+            for (int e = E_CYCLES; e < NEVENTS; e++)
+                if (c[e] >= 0) v[m][M_CYCLES_TOKEN + e] = c[e] / tokens;
+        }
+    }
+
+    FILE *f = fopen(out_path, "w");
+    if (!f) {
+        perror(out_path);
+        return 1;
+    }
+    fprintf(f, "# mode metric value\n");
+    for (int m = 0; m < NMODES; m++)
+        for (int k = 0; k < NMETRICS; k++)
+            if (v[m][k] >= 0) fprintf(f, "%s %s %.10g\n", modes[m], metrics[k], v[m][k]);
+    fclose(f);
+
+    double base[NMODES][NMETRICS];
+    int have_base = base_path && load(base_path, base);
+    int regressed = 0;
+    printf("%-6s %-14s %14s %14s %9s\n", "mode", "metric", "value", "baseline", "change");
+    for (int m = 0; m < NMODES; m++) {
+        for (int k = 0; k < NMETRICS; k++) {
+            if (v[m][k] < 0) continue;
+            printf("%-6s %-14s %14.2f", modes[m], metrics[k], v[m][k]);
+            if (!have_base || base[m][k] <= 0) {
+                printf("\n");
+                continue;
+            }
+            double change = (v[m][k] / base[m][k] - 1) * 100;
+            int bad = better[k] != 0 && change * better[k] < -threshold;
+            printf(" %14.2f %+8.1f%%%s\n", base[m][k], change, bad ? "  REGRESSED" : "");
+            regressed |= bad;
+        }
+    }
+    // The parse mode minus the scan mode: what the yacc loop itself costs
+    if (counters) {
+        double *s = events_best[0], *p = events_best[1];
+        double cyc = p[E_CYCLES] - s[E_CYCLES], ins = p[E_INSNS] - s[E_INSNS];
+        if (s[E_CYCLES] > 0 && p[E_CYCLES] > 0 && cyc > 0)
+            printf("%-6s %-14s %14.2f\n", "yacc", "ipc", ins / cyc);
+        for (int e = E_CYCLES; e < NEVENTS; e++)
+            if (s[e] >= 0 && p[e] >= 0)
+                printf("%-6s %-14s %14.2f\n", "yacc", metrics[M_CYCLES_TOKEN + e],
+                       (p[e] - s[e]) / tokens);
+    }
+    if (base_path && !have_base)
+        printf("no baseline in %s; make bench-baseline records one\n", base_path);
+    if (regressed)
+        printf("regression beyond %.0f%% against %s\n", threshold, base_path);
+    return regressed;
+}
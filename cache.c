@@ -0,0 +1,425 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+
+#include "cache.h"
+#include "ast.h"
+#include "mem.h"
+
+// The scanner's symbol table and the parser's error count
+extern char **symbolTable;
+extern int nsymbols;
+void create();
+int insert(char *s);
+extern int errors;
+
+#define CACHE_MAGIC "SDPC"
+#define MAX_PATH 4096
+
+// ---- hashing --------------------------------------------------------------
+
+// 64-bit hash in the manner of XXH64: four lanes of 8 bytes, so long inputs
+// hash at memory speed. Words are read in host order; entries never leave
+// the machine that wrote them.
+#define P1 0x9E3779B185EBCA87ULL
+#define P2 0xC2B2AE3D27D4EB4FULL
+#define P3 0x165667B19E3779F9ULL
+#define P4 0x85EBCA77C2B2AE63ULL
+
+static uint64_t rotl(uint64_t x, int r) {
+    return x << r | x >> (64 - r);
+}
+
+static uint64_t word(const unsigned char *p) {
+    uint64_t w;
+    memcpy(&w, p, 8);
+    return w;
+}
+
+static uint64_t mix(uint64_t acc, uint64_t w) {
+    return rotl(acc + w * P2, 31) * P1;
+}
+
+uint64_t content_hash(const void *data, size_t n, uint64_t seed) {
+    const unsigned char *p = data, *end = p + n;
+    uint64_t h;
+    if (n >= 32) {
+        uint64_t v1 = seed + P1 + P2, v2 = seed + P2, v3 = seed, v4 = seed - P1;
+        do {
+            v1 = mix(v1, word(p));
+            v2 = mix(v2, word(p + 8));
+            v3 = mix(v3, word(p + 16));
+            v4 = mix(v4, word(p + 24));
+            p += 32;
+        } while (p + 32 <= end);
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    } else {
+        h = seed + P3;
+    }
+    h += n;
+    for (; p + 8 <= end; p += 8) h = rotl(h ^ mix(0, word(p)), 27) * P1 + P4;
+    for (; p < end; p++) h = rotl(h ^ *p * P3, 11) * P1;
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    return h ^ h >> 32;
+}
+
+uint64_t cache_key(const char *text, size_t len, const void *opts, size_t opts_len) {
+    uint64_t seed = content_hash(TOOL_VERSION, sizeof(TOOL_VERSION), sizeof(Node));
+    return content_hash(text, len, content_hash(opts, opts_len, seed));
+}
+
+// ---- entry encoding -------------------------------------------------------
+
+typedef struct {
+    char *p;
+    size_t n;
+    size_t cap;
+} Bytes;
+
+static void put(Bytes *b, const void *s, size_t n) {
+    if (b->n + n > b->cap) {
+        while (b->n + n > b->cap) b->cap = b->cap ? b->cap * 2 : 4096;
+        b->p = mem_realloc(b->p, b->cap);
+    }
+    memcpy(b->p + b->n, s, n);
+    b->n += n;
+}
+
+static void put32(Bytes *b, uint32_t v) {
+    put(b, &v, 4);
+}
+
+// Reading side: a cursor that goes bad instead of running past the end
+typedef struct {
+    const char *p, *end;
+    int bad;
+} Cursor;
+
+static const void *get(Cursor *c, size_t n) {
+    if ((size_t)(c->end - c->p) < n) {
+        c->bad = 1;
+        return NULL;
+    }
+    c->p += n;
+    return c->p - n;
+}
+
+// Copy n bytes out, zeros if they are not there; entries are not aligned
+static void get_into(Cursor *c, void *dst, size_t n) {
+    const void *s = get(c, n);
+    if (s) memcpy(dst, s, n);
+    else memset(dst, 0, n);
+}
+
+static uint32_t get32(Cursor *c) {
+    uint32_t v;
+    get_into(c, &v, 4);
+    return v;
+}
+
+// Node record: kind, op, flags, which of a, b, c, d and next follow, line,
+// sym, then the literal value. Children come right after their parent in
+// the order a, b, c, d, next, written with an explicit stack: deep nesting
+// and long lists would overflow the C stack.
+typedef struct {
+    short kind, op, flags, present;
+    int line, sym;
+} Record;
+
+static Node **child(Node *n, int i) {
+    Node **slots[5] = { &n->a, &n->b, &n->c, &n->d, &n->next };
+    return slots[i];
+}
+
+static void put_tree(Bytes *b, Node *root) {
+    Node **stack = NULL;
+    long depth = 0, cap = 0, count = 0;
+    Bytes nodes = { NULL, 0, 0 };
+    if (root) {
+        stack = mem_alloc(sizeof(Node *) * (cap = 1024));
+        stack[depth++] = root;
+    }
+    while (depth > 0) {
+        Node *n = stack[--depth];
+        Record r = { n->kind, n->op, n->flags, 0, n->line, n->sym };
+        for (int i = 0; i < 5; i++)
+            if (*child(n, i)) r.present |= 1 << i;
+        put(&nodes, &r, sizeof(r));
+        if (n->kind == N_STRING) {
+            uint32_t k = strlen(n->v.s);
+            put32(&nodes, k);
+            put(&nodes, n->v.s, k);
+        } else if (n->kind == N_INT || n->kind == N_REAL || n->kind == N_BOOL ||
+                   n->kind == N_FUNC) {
+            put(&nodes, &n->v, sizeof(n->v));
+        }
+        if (depth + 5 > cap) stack = mem_realloc(stack, sizeof(Node *) * (cap *= 2));
+        for (int i = 4; i >= 0; i--)
+            if (*child(n, i)) stack[depth++] = *child(n, i);
+        count++;
+    }
+    put(b, &count, sizeof(count));
+    put(b, nodes.p, nodes.n);
+    mem_free(nodes.p);
+    mem_free(stack);
+}
+
+static Node *get_tree(Cursor *c) {
+    long count;
+    Node *root = NULL;
+    get_into(c, &count, sizeof(count));
+    if (count == 0) return NULL;
+    long depth = 0, cap = 1024;
+    Node ***stack = mem_alloc(sizeof(Node **) * cap);
+    stack[depth++] = &root;
+    for (long k = 0; k < count && depth > 0 && !c->bad; k++) {
+        Record r;
+        get_into(c, &r, sizeof(r));
+        if (c->bad) break;
+        Node *n = ast_alloc(sizeof(Node));
+        memset(n, 0, sizeof(Node));
+        n->kind = r.kind;
+        n->op = r.op;
+        n->flags = r.flags;
+        n->line = r.line;
+        n->sym = r.sym;
+        n->decl = -1;
+        if (n->kind == N_STRING) {
+            uint32_t len = get32(c);
+            const char *s = get(c, len);
+            n->v.s = s ? ast_strndup(s, len) : NULL;
+        } else if (n->kind == N_INT || n->kind == N_REAL || n->kind == N_BOOL ||
+                   n->kind == N_FUNC) {
+            get_into(c, &n->v, sizeof(n->v));
+        }
+        *stack[--depth] = n;
+        if (depth + 5 > cap) stack = mem_realloc(stack, sizeof(Node **) * (cap *= 2));
+        for (int i = 4; i >= 0; i--)
+            if (r.present & 1 << i) stack[depth++] = child(n, i);
+    }
+    if (depth != 0 || c->bad) c->bad = 1;
+    mem_free(stack);
+    return root;
+}
+
+// ---- diagnostics ----------------------------------------------------------
+
+static Bytes diags;
+static pthread_mutex_t diag_lock = PTHREAD_MUTEX_INITIALIZER;
+static int recording = 0;
+static _Thread_local Bytes held;
+static _Thread_local int holding = 0;
+
+// Append a formatted message to b, however long it is
+static void put_format(Bytes *b, const char *fmt, va_list ap) {
+    va_list again;
+    va_copy(again, ap);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    if (n > 0) {
+        if (b->n + n + 1 > b->cap) {
+            while (b->n + n + 1 > b->cap) b->cap = b->cap ? b->cap * 2 : 4096;
+            b->p = mem_realloc(b->p, b->cap);
+        }
+        vsnprintf(b->p + b->n, n + 1, fmt, again);
+        b->n += n;
+    }
+    va_end(again);
+}
+
+void diag(const char *fmt, ...) {
+    va_list ap;
+    if (holding) {
+        va_start(ap, fmt);
+        put_format(&held, fmt, ap);
+        va_end(ap);
+        return;
+    }
+    // The --pipeline scanner thread reports errors too; the lock keeps the
+    // recorded order the printed one
+    pthread_mutex_lock(&diag_lock);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    if (recording) {
+        va_start(ap, fmt);
+        put_format(&diags, fmt, ap);
+        va_end(ap);
+    }
+    pthread_mutex_unlock(&diag_lock);
+}
+
+void diag_hold(void) {
+    held.n = 0;
+    holding = 1;
+}
+
+char *diag_release(size_t *len) {
+    char *text = held.p;
+    *len = held.n;
+    held.p = NULL;
+    held.n = held.cap = 0;
+    holding = 0;
+    return text;
+}
+
+void diag_emit(const char *text, size_t len) {
+    if (len == 0) return;
+    pthread_mutex_lock(&diag_lock);
+    fwrite(text, 1, len, stderr);
+    if (recording) put(&diags, text, len);
+    pthread_mutex_unlock(&diag_lock);
+}
+
+void cache_record(void) {
+    diags.n = 0;
+    recording = 1;
+}
+
+// ---- the cache directory --------------------------------------------------
+
+static void entry_path(char *path, const char *dir, uint64_t key) {
+    snprintf(path, MAX_PATH, "%s/%016llx.sdc", dir, (unsigned long long)key);
+}
+
+int cache_load(const char *dir, uint64_t key, int *status) {
+    char path[MAX_PATH];
+    entry_path(path, dir, key);
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) return 0;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *data = mem_alloc(size > 0 ? size : 1);
+    size = fread(data, 1, size, f);
+    fclose(f);
+
+    Cursor c = { data, data + size, 0 };
+    const char *magic = get(&c, 4);
+    uint64_t stored;
+    get_into(&c, &stored, sizeof(stored));
+    if (magic == NULL || memcmp(magic, CACHE_MAGIC, 4) != 0 || stored != key) {
+        mem_free(data);
+        return 0;
+    }
+    int st = get32(&c), errs = get32(&c);
+    uint32_t dlen = get32(&c);
+    const char *d = get(&c, dlen);
+    uint32_t nsyms = get32(&c);
+    // Check the whole entry before anything is restored
+    Cursor names = c;
+    for (uint32_t i = 0; i < nsyms && !c.bad; i++) get(&c, get32(&c));
+    Cursor tree = c;
+    if (c.bad) {
+        mem_free(data);
+        return 0;
+    }
+
+    create();
+    for (uint32_t i = 0; i < nsyms; i++) {
+        uint32_t k = get32(&names);
+        char *name = mem_alloc(k + 1);
+        memcpy(name, get(&names, k), k);
+        name[k] = '\0';
+        insert(name);
+        mem_free(name);
+    }
+    program = get_tree(&tree);
+    if (tree.bad) {
+        // Unreadable tree: parse again as if there were no entry
+        ast_free();
+        create();
+        mem_free(data);
+        return 0;
+    }
+    fwrite(d, 1, dlen, stderr);
+    errors += errs;
+    *status = st;
+    mem_free(data);
+    utime(path, NULL);     // most recently used
+    return 1;
+}
+
+typedef struct {
+    char name[256];
+    long size;
+    long long used;     // mtime in ns
+} Entry;
+
+static int by_use(const void *a, const void *b) {
+    const Entry *x = a, *y = b;
+    return (x->used > y->used) - (x->used < y->used);
+}
+
+// Remove least recently used entries until the directory fits in limit
+static void evict(const char *dir, long limit) {
+    DIR *d = opendir(dir);
+    if (d == NULL) return;
+    Entry *e = NULL;
+    int n = 0, cap = 0;
+    long total = 0;
+    char path[MAX_PATH];
+    struct dirent *de;
+    struct stat st;
+    while ((de = readdir(d)) != NULL) {
+        size_t k = strlen(de->d_name);
+        if (k < 4 || k >= sizeof(e->name) || strcmp(de->d_name + k - 4, ".sdc") != 0) continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+        if (stat(path, &st) != 0) continue;
+        if (n == cap) e = mem_realloc(e, sizeof(Entry) * (cap = cap ? cap * 2 : 64));
+        strcpy(e[n].name, de->d_name);
+        e[n].size = st.st_size;
+        e[n].used = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+        total += st.st_size;
+        n++;
+    }
+    closedir(d);
+    if (total > limit) {
+        qsort(e, n, sizeof(Entry), by_use);
+        for (int i = 0; i < n && total > limit; i++) {
+            snprintf(path, sizeof(path), "%s/%s", dir, e[i].name);
+            if (unlink(path) == 0) total -= e[i].size;
+        }
+    }
+    mem_free(e);
+}
+
+void cache_store(const char *dir, uint64_t key, int status, long limit) {
+    Bytes b = { NULL, 0, 0 };
+    put(&b, CACHE_MAGIC, 4);
+    put(&b, &key, sizeof(key));
+    put32(&b, status);
+    put32(&b, errors);
+    put32(&b, diags.n);
+    put(&b, diags.p, diags.n);
+    put32(&b, nsymbols);
+    for (int i = 0; i < nsymbols; i++) {
+        uint32_t k = strlen(symbolTable[i]);
+        put32(&b, k);
+        put(&b, symbolTable[i], k);
+    }
+    put_tree(&b, program);
+    recording = 0;
+
+    // Write under a temporary name, then rename, so readers never see half
+    // an entry
+    char path[MAX_PATH], tmp[MAX_PATH + 32];   // room for the suffix
+    mkdir(dir, 0777);
+    entry_path(path, dir, key);
+    snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long)getpid());
+    FILE *f = fopen(tmp, "wb");
+    int ok = f != NULL && fwrite(b.p, 1, b.n, f) == b.n;
+    if (f != NULL && fclose(f) != 0) ok = 0;
+    if (ok) ok = rename(tmp, path) == 0;
+    if (!ok) unlink(tmp);
+    mem_free(b.p);
+    evict(dir, limit);
+}
@@ -0,0 +1,38 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Parse cache (--cache DIR): the result of parsing an input kept on disk
+// under a hash of its content, the tool version and the options that change
+// the result, so an unchanged file is not scanned or parsed again. An entry
+// holds the parse status, error count, diagnostics, symbol table and tree.
+// A hit refreshes the entry's mtime; once the directory is over its size
+// limit, the least recently used entries go first.
+
+// Bump whenever the grammar, the tree or the entry layout changes
+#define TOOL_VERSION "sd-parser 3"
+
+uint64_t content_hash(const void *p, size_t n, uint64_t seed);
+uint64_t cache_key(const char *text, size_t len, const void *opts, size_t opts_len);
+
+// On a hit, print the entry's diagnostics, restore errors, the symbol table
+// and program, set *status and return 1
+int cache_load(const char *dir, uint64_t key, int *status);
+
+// Diagnostics go through diag(); after cache_record() they are also kept
+// for the next cache_store()
+void diag(const char *fmt, ...);
+void cache_record(void);
+
+// Between diag_hold() and diag_release() this thread's diagnostics are kept
+// back; diag_release returns them as one block of text (mem_free it), for
+// diag_emit to print and record once their turn comes
+void diag_hold(void);
+char *diag_release(size_t *len);
+void diag_emit(const char *text, size_t len);
+// Save the parse just done, then evict down to limit bytes
+void cache_store(const char *dir, uint64_t key, int status, long limit);
+
+#endif
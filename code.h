@@ -0,0 +1,106 @@
+#ifndef CODE_H
+#define CODE_H
+
+#include "ast.h"
+
+// Bytecode for a stack machine. An instruction is an opcode word followed
+// by its operands, one word each; values live in a separate array. Types
+// were settled by the checker, so every operation is typed and values carry
+// no tag: ints, chars and bools are i, floats and doubles r (a float
+// rounded to float precision), strings s.
+typedef union {
+    long long i;
+    double r;
+    const char *s;
+} Value;
+
+// X(name, operands, stack effect)
+#define OPCODES(X) \
+    X(HALT, 0, 0) \
+    X(PUSH, 1, 1)       /* k: constant k */ \
+    X(POP, 0, -1) \
+    X(LOAD_G, 1, 1)     /* slot: global variable */ \
+    X(STORE_G, 1, -1) \
+    X(LOAD_L, 1, 1)     /* slot: variable in the running call's frame */ \
+    X(STORE_L, 1, -1) \
+    X(ADD_I, 0, -1) \
+    X(SUB_I, 0, -1) \
+    X(MUL_I, 0, -1) \
+    X(DIV_I, 0, -1) \
+    X(MOD_I, 0, -1) \
+    X(NEG_I, 0, 0) \
+    X(ADD_F, 0, -1) \
+    X(SUB_F, 0, -1) \
+    X(MUL_F, 0, -1) \
+    X(DIV_F, 0, -1) \
+    X(NEG_F, 0, 0) \
+    X(LT_I, 0, -1) \
+    X(LE_I, 0, -1) \
+    X(GT_I, 0, -1) \
+    X(GE_I, 0, -1) \
+    X(EQ_I, 0, -1) \
+    X(NE_I, 0, -1) \
+    X(LT_F, 0, -1) \
+    X(LE_F, 0, -1) \
+    X(GT_F, 0, -1) \
+    X(GE_F, 0, -1) \
+    X(EQ_F, 0, -1) \
+    X(NE_F, 0, -1) \
+    X(EQ_S, 0, -1) \
+    X(NE_S, 0, -1) \
+    X(NOT, 0, 0) \
+    X(I2F, 0, 0)        /* int to double */ \
+    X(F2I, 0, 0)        /* double to int, toward zero */ \
+    X(TO_FLOAT, 0, 0)   /* round to float precision */ \
+    X(TO_CHAR, 0, 0)    /* wrap to a char */ \
+    X(JUMP, 1, 0)       /* to: code offset */ \
+    X(JZ, 1, -1)        /* pop, jump if zero */ \
+    X(JNZ, 1, -1) \
+    X(DIR, 0, -1)       /* from to: 1 counting up to it, -1 down */ \
+    X(PAST, 0, -2)      /* var end dir: var has gone past end */ \
+    X(CALL, 1, 0)       /* f: function symbol id; arguments replaced by result */ \
+    X(RET, 0, -1) \
+    X(RET_VOID, 0, 0) \
+    X(PRINT_I, 0, -1) \
+    X(PRINT_F, 0, -1) \
+    X(PRINT_B, 0, -1) \
+    X(PRINT_C, 0, -1) \
+    X(PRINT_S, 0, -1) \
+    X(NEWLINE, 0, 0) \
+    X(READ_I, 0, 1) \
+    X(READ_F, 0, 1) \
+    X(READ_B, 0, 1) \
+    X(READ_C, 0, 1) \
+    X(READ_S, 0, 1)
+
+#define OP_ENUM(name, operands, effect) OP_##name,
+enum { OPCODES(OP_ENUM) NOPCODES };
+#undef OP_ENUM
+
+typedef struct {
+    int entry;              // code offset of its first instruction
+    int nparams;
+    int nslots;             // frame size: parameters, locals, temporaries
+    int maxstack;           // deepest its operand stack gets
+    int ret;                // return type
+} Func;
+
+// A compiled program: code that initializes the globals and calls main,
+// then the functions
+typedef struct {
+    int *code;
+    int *lines;             // source line of each code word
+    int ncode, cap_code;
+    Value *consts;
+    int nconsts, cap_consts;
+    Func *funcs;            // by function symbol id
+    int nglobals;           // global slots
+    int maxstack;           // deepest the initializing code's stack gets
+} Program;
+
+// Compile a checked tree without errors; NULL, with the error reported, if
+// it nests too deeply
+Program *compile(Node *program);
+void program_free(Program *p);
+
+#endif
@@ -0,0 +1,500 @@
+#include <assert.h>
+#include <string.h>
+
+#include "code.h"
+#include "scope.h"
+#include "types.h"
+#include "sema.h"
+#include "token.h"
+#include "mem.h"
+
+extern char **symbolTable;
+
+// Statements and expressions compile recursively; past this depth the
+// program is refused rather than the C stack overflowed
+#define MAX_NESTING 10000
+
+static Program *p;
+static int depth, maxdepth;     // operand stack depth now and at most
+static int nesting;
+static int deep_line;           // where MAX_NESTING was hit, 0 if not
+static Func *func;              // function being compiled, NULL for the globals'
+static int temps, most_temps;   // temporaries in use past func's variables, at most
+
+static const signed char effect[] = {
+#define OP_EFFECT(name, operands, effect) effect,
+    OPCODES(OP_EFFECT)
+#undef OP_EFFECT
+};
+
+static void word(int w, int line) {
+    if (p->ncode == p->cap_code) {
+        p->cap_code = p->cap_code ? p->cap_code * 2 : 1024;
+        p->code = mem_realloc(p->code, p->cap_code * sizeof(int));
+        p->lines = mem_realloc(p->lines, p->cap_code * sizeof(int));
+    }
+    p->code[p->ncode] = w;
+    p->lines[p->ncode++] = line;
+}
+
+static void adjust(int d) {
+    depth += d;
+    if (depth > maxdepth) maxdepth = depth;
+}
+
+static void emit(int op, int line) {
+    word(op, line);
+    adjust(effect[op]);
+}
+
+// Emit an instruction with one operand; returns the operand's offset
+static int emit1(int op, int x, int line) {
+    emit(op, line);
+    word(x, line);
+    return p->ncode - 1;
+}
+
+static void patch(int at) {
+    p->code[at] = p->ncode;
+}
+
+static void push(Value v, int line) {
+    if (p->nconsts == p->cap_consts) {
+        p->cap_consts = p->cap_consts ? p->cap_consts * 2 : 64;
+        p->consts = mem_realloc(p->consts, p->cap_consts * sizeof(Value));
+    }
+    p->consts[p->nconsts] = v;
+    emit1(OP_PUSH, p->nconsts++, line);
+}
+
+static int real(int t) {
+    return t == TY_FLOAT || t == TY_DOUBLE;
+}
+
+static void zero(int t, int line) {
+    Value v = { 0 };
+    if (t == TY_STRING) v.s = "";
+    push(v, line);
+}
+
+// Convert the value on top from type from to type to, as assigning does
+static void convert(int from, int to, int line) {
+    if (from == to) return;
+    if (!real(from) && real(to)) emit(OP_I2F, line);
+    if (real(from) && !real(to)) emit(OP_F2I, line);
+    if (to == TY_FLOAT) emit(OP_TO_FLOAT, line);
+    if (to == TY_CHAR) emit(OP_TO_CHAR, line);
+}
+
+// A temporary variable of the function being compiled: a frame slot past
+// its variables'
+static int temp(void) {
+    if (temps == most_temps) most_temps++;
+    return func->nslots + temps++;
+}
+
+// Variable id's value onto the stack, or the stack's top into it; names
+// were given their slots as they were resolved (scope.h)
+static void load(int id, int line) {
+    emit1(syms.kind[id] == S_GLOBAL ? OP_LOAD_G : OP_LOAD_L, syms.slot[id], line);
+}
+
+static void store(int id, int line) {
+    emit1(syms.kind[id] == S_GLOBAL ? OP_STORE_G : OP_STORE_L, syms.slot[id], line);
+}
+
+static void expr(Node *n);
+
+static void expr_as(Node *n, int t) {
+    expr(n);
+    convert(type_of(n), t, n->line);
+}
+
+static void logical(Node *n) {
+    // a && b: b if a, else false; a || b: true if a, else b
+    expr(n->a);
+    int skip = emit1(n->op == AND ? OP_JZ : OP_JNZ, 0, n->line);
+    expr(n->b);
+    int end = emit1(OP_JUMP, 0, n->line);
+    adjust(-1);
+    patch(skip);
+    push((Value){ .i = n->op == OR }, n->line);
+    patch(end);
+}
+
+static void binary(Node *n) {
+    static const int ints[] = { ['+'] = OP_ADD_I, ['-'] = OP_SUB_I, ['*'] = OP_MUL_I,
+                                ['/'] = OP_DIV_I, ['%'] = OP_MOD_I, ['<'] = OP_LT_I,
+                                ['>'] = OP_GT_I };
+    int a = type_of(n->a), b = type_of(n->b), t = n->type, op;
+    if (n->op == AND || n->op == OR) {
+        logical(n);
+        return;
+    }
+    switch (n->op) {
+    case '+': case '-': case '*': case '/': case '%':
+        // float arithmetic is done in double and rounded
+        expr_as(n->a, real(t) ? TY_DOUBLE : t);
+        expr_as(n->b, real(t) ? TY_DOUBLE : t);
+        op = ints[n->op];
+        emit(real(t) ? op + (OP_ADD_F - OP_ADD_I) : op, n->line);
+        if (t == TY_FLOAT) emit(OP_TO_FLOAT, n->line);
+        return;
+    }
+    switch (n->op) {
+    case LE: op = OP_LE_I; break;
+    case GE: op = OP_GE_I; break;
+    case EQ: op = OP_EQ_I; break;
+    case NE: op = OP_NE_I; break;
+    default: op = ints[n->op]; break;
+    }
+    if (a == TY_STRING) {
+        expr(n->a);
+        expr(n->b);
+        emit(n->op == EQ ? OP_EQ_S : OP_NE_S, n->line);
+    } else if (real(a) || real(b)) {
+        expr_as(n->a, TY_DOUBLE);
+        expr_as(n->b, TY_DOUBLE);
+        emit(op + (OP_LT_F - OP_LT_I), n->line);
+    } else {
+        expr(n->a);
+        expr(n->b);
+        emit(op, n->line);
+    }
+}
+
+static void call(Node *n) {
+    const FuncType *f = func_type(syms.type[n->decl]);
+    int k = 0;
+    for (Node *a = n->a; a; a = a->next) expr_as(a, f->params[k++]);
+    emit1(OP_CALL, n->decl, n->line);
+    adjust(-k + (f->ret != TY_VOID));
+}
+
+static int too_deep(const Node *n) {
+    if (nesting < MAX_NESTING) return 0;
+    if (!deep_line) deep_line = n->line;
+    return 1;
+}
+
+static void expr(Node *n) {
+    if (too_deep(n)) return;
+    nesting++;
+    switch (n->kind) {
+    case N_INT:
+    case N_BOOL:
+        push((Value){ .i = n->v.i }, n->line);
+        break;
+    case N_REAL:
+        push((Value){ .r = n->v.r }, n->line);
+        break;
+    case N_STRING:
+        push((Value){ .s = n->v.s }, n->line);
+        break;
+    case N_NAME:
+        load(n->decl, n->line);
+        break;
+    case N_CALL:
+        call(n);
+        break;
+    case N_BINARY:
+        binary(n);
+        break;
+    case N_UNARY:
+        if (n->op == '!') {
+            expr(n->a);
+            emit(OP_NOT, n->line);
+        } else {
+            expr_as(n->a, real(n->type) ? TY_DOUBLE : n->type);
+            emit(real(n->type) ? OP_NEG_F : OP_NEG_I, n->line);
+        }
+        break;
+    }
+    nesting--;
+}
+
+// ---- statements -----------------------------------------------------------
+
+// Jumps out of the innermost loop waiting for their target
+typedef struct {
+    int *at;
+    int n, cap;
+} Patches;
+
+static Patches *breaks, *continues;
+
+static void later(Patches *l, int at) {
+    if (l->n == l->cap) {
+        l->cap = l->cap ? l->cap * 2 : 8;
+        l->at = mem_realloc(l->at, l->cap * sizeof(int));
+    }
+    l->at[l->n++] = at;
+}
+
+static void land(Patches *l) {
+    for (int i = 0; i < l->n; i++) patch(l->at[i]);
+    mem_free(l->at);
+}
+
+static void stmt(Node *n);
+
+static void stmts(Node *n) {
+    for (; n; n = n->next) stmt(n);
+}
+
+// Compile a loop body with its own break and continue lists; continues
+// land where the next iteration starts, breaks once the loop is compiled
+static void body(Node *n, Patches *brk, void (*step)(Node *), Node *loop) {
+    Patches cont = { 0 };
+    Patches *outer_brk = breaks, *outer_cont = continues;
+    breaks = brk;
+    continues = &cont;
+    stmt(n);
+    breaks = outer_brk;
+    continues = outer_cont;
+    land(&cont);
+    if (step) step(loop);
+}
+
+static void for_step(Node *n) {
+    if (n->c) stmt(n->c);
+}
+
+// The foreach variable and its direction, a temporary set once before the
+// loop as the end is
+static int each_var, each_dir;
+
+static void each_step(Node *n) {
+    load(each_var, n->line);
+    emit1(OP_LOAD_L, each_dir, n->line);
+    emit(OP_ADD_I, n->line);
+    if (syms.type[each_var] == TY_CHAR) emit(OP_TO_CHAR, n->line);
+    store(each_var, n->line);
+}
+
+static void foreach(Node *n) {
+    int var = n->decl, t = syms.type[var];
+    int end = temp(), dir = temp();
+    expr_as(n->a, t);
+    store(var, n->line);
+    expr_as(n->b, t);
+    emit1(OP_STORE_L, end, n->line);
+    load(var, n->line);
+    emit1(OP_LOAD_L, end, n->line);
+    emit(OP_DIR, n->line);
+    emit1(OP_STORE_L, dir, n->line);
+    int test = emit1(OP_JUMP, 0, n->line);
+    int top = p->ncode;
+    Patches brk = { 0 };
+    int saved[2] = { each_var, each_dir };
+    each_var = var;
+    each_dir = dir;
+    body(n->c, &brk, each_step, n);
+    patch(test);
+    load(var, n->line);
+    emit1(OP_LOAD_L, end, n->line);
+    emit1(OP_LOAD_L, dir, n->line);
+    emit(OP_PAST, n->line);
+    emit1(OP_JZ, top, n->line);
+    land(&brk);
+    each_var = saved[0];
+    each_dir = saved[1];
+    temps -= 2;
+}
+
+static void ret(Node *n) {
+    if (n->a) {
+        expr_as(n->a, func->ret);
+        emit(OP_RET, n->line);
+    } else if (func->ret != TY_VOID) {
+        zero(func->ret, n->line);
+        emit(OP_RET, n->line);
+    } else {
+        emit(OP_RET_VOID, n->line);
+    }
+}
+
+static void print(Node *n) {
+    int t = type_of(n->a);
+    expr(n->a);
+    emit(t == TY_STRING ? OP_PRINT_S
+         : t == TY_BOOL ? OP_PRINT_B
+         : t == TY_CHAR ? OP_PRINT_C
+         : real(t) ? OP_PRINT_F : OP_PRINT_I, n->line);
+    if (n->op == PRINTLN) emit(OP_NEWLINE, n->line);
+}
+
+static void read(Node *n) {
+    int t = syms.type[n->decl];
+    emit(t == TY_STRING ? OP_READ_S
+         : t == TY_BOOL ? OP_READ_B
+         : t == TY_CHAR ? OP_READ_C
+         : real(t) ? OP_READ_F : OP_READ_I, n->line);
+    if (t == TY_FLOAT) emit(OP_TO_FLOAT, n->line);
+    store(n->decl, n->line);
+}
+
+static void stmt(Node *n) {
+    if (n == NULL || too_deep(n)) return;
+    nesting++;
+    switch (n->kind) {
+    case N_VAR:
+        if (n->a) expr_as(n->a, n->op);
+        else zero(n->op, n->line);
+        store(n->decl, n->line);
+        break;
+    case N_BLOCK:
+        stmts(n->a);
+        break;
+    case N_ASSIGN:
+        expr_as(n->a, syms.type[n->decl]);
+        store(n->decl, n->line);
+        break;
+    case N_INCR: {
+        int t = syms.type[n->decl];
+        load(n->decl, n->line);
+        push(real(t) ? (Value){ .r = 1 } : (Value){ .i = 1 }, n->line);
+        if (n->op == INC) emit(real(t) ? OP_ADD_F : OP_ADD_I, n->line);
+        else emit(real(t) ? OP_SUB_F : OP_SUB_I, n->line);
+        convert(real(t) ? TY_DOUBLE : TY_INT, t, n->line);
+        store(n->decl, n->line);
+        break;
+    }
+    case N_PRINT:
+        print(n);
+        break;
+    case N_READ:
+        read(n);
+        break;
+    case N_RETURN:
+        ret(n);
+        break;
+    case N_EXPR:
+        expr(n->a);
+        if (type_of(n->a) != TY_VOID) emit(OP_POP, n->line);
+        break;
+    case N_IF: {
+        expr(n->a);
+        int skip = emit1(OP_JZ, 0, n->line);
+        stmt(n->b);
+        if (n->c) {
+            int end = emit1(OP_JUMP, 0, n->line);
+            patch(skip);
+            stmt(n->c);
+            patch(end);
+        } else {
+            patch(skip);
+        }
+        break;
+    }
+    case N_WHILE:
+    case N_FOR: {
+        // The test goes after the body, so an iteration takes one jump
+        Node *cond = n->kind == N_WHILE ? n->a : n->b;
+        Node *loop = n->kind == N_WHILE ? n->b : n->d;
+        if (n->kind == N_FOR && n->a) stmt(n->a);
+        int test = emit1(OP_JUMP, 0, n->line);
+        int top = p->ncode;
+        Patches brk = { 0 };
+        body(loop, &brk, n->kind == N_FOR ? for_step : NULL, n);
+        patch(test);
+        if (cond) {
+            expr(cond);
+            emit1(OP_JNZ, top, n->line);
+        } else {
+            emit1(OP_JUMP, top, n->line);
+        }
+        land(&brk);
+        break;
+    }
+    case N_FOREACH:
+        foreach(n);
+        break;
+    // The checker refused either one outside a loop
+    case N_BREAK:
+        assert(breaks);
+        later(breaks, emit1(OP_JUMP, 0, n->line));
+        break;
+    case N_CONTINUE:
+        assert(continues);
+        later(continues, emit1(OP_JUMP, 0, n->line));
+        break;
+    }
+    nesting--;
+}
+
+// ---- program --------------------------------------------------------------
+
+static void function(Node *f) {
+    Func *fn = &p->funcs[f->decl];
+    const FuncType *t = func_type(syms.type[f->decl]);
+    fn->entry = p->ncode;
+    fn->nparams = t->nparams;
+    fn->ret = t->ret;
+    fn->nslots = syms.slot[f->decl];
+    func = fn;
+    depth = maxdepth = temps = most_temps = 0;
+    for (Node *s = f->b ? f->b->a : NULL; s; s = s->next) stmt(s);
+    // Falling off the end returns nothing, or a zero
+    if (fn->ret == TY_VOID) {
+        emit(OP_RET_VOID, f->line);
+    } else {
+        zero(fn->ret, f->line);
+        emit(OP_RET, f->line);
+    }
+    fn->maxstack = maxdepth;
+    fn->nslots += most_temps;
+    func = NULL;
+}
+
+Program *compile(Node *program) {
+    p = mem_calloc(1, sizeof(Program));
+    p->nglobals = syms.global_slots;
+    p->funcs = mem_calloc(syms.nglobal ? syms.nglobal : 1, sizeof(Func));
+    nesting = deep_line = 0;
+    depth = maxdepth = 0;
+
+    // A string global a function reads before its initializer has run is
+    // "", not a null pointer; the others' zero is all zero bits already
+    for (Node *n = program; n; n = n->next) {
+        if (n->kind == N_VAR && n->op == TY_STRING) {
+            zero(TY_STRING, n->line);
+            store(n->decl, n->line);
+        }
+    }
+
+    // Globals in order, then main
+    Node *main = NULL;
+    for (Node *n = program; n; n = n->next) {
+        if (n->kind == N_VAR) stmt(n);
+        else if (n->decl >= 0 && strcmp(symbolTable[n->sym], "main") == 0) main = n;
+    }
+    if (main) {
+        const FuncType *t = func_type(syms.type[main->decl]);
+        for (int k = 0; k < t->nparams; k++) zero(t->params[k], main->line);
+        emit1(OP_CALL, main->decl, main->line);
+        adjust(-t->nparams + (t->ret != TY_VOID));
+        if (t->ret != TY_VOID) emit(OP_POP, main->line);
+    }
+    emit(OP_HALT, 0);
+    p->maxstack = maxdepth;
+
+    for (Node *n = program; n; n = n->next) {
+        if (n->kind == N_FUNC) function(n);
+    }
+    if (deep_line) {
+        sema_error(deep_line, "nesting too deep to compile");
+        program_free(p);
+        return NULL;
+    }
+    return p;
+}
+
+void program_free(Program *prog) {
+    if (prog == NULL) return;
+    mem_free(prog->code);
+    mem_free(prog->lines);
+    mem_free(prog->consts);
+    mem_free(prog->funcs);
+    mem_free(prog);
+}
@@ -0,0 +1,164 @@
+#include <limits.h>
+#include <string.h>
+
+#include "fold.h"
+#include "scope.h"
+#include "types.h"
+#include "token.h"
+
+static int literal(const Node *n) {
+    return n->kind == N_INT || n->kind == N_REAL || n->kind == N_BOOL || n->kind == N_STRING;
+}
+
+static double real(const Node *n) {
+    return n->kind == N_REAL ? n->v.r : (double)n->v.i;
+}
+
+// Turn n into a literal of kind; its operands are dropped, the value is
+// left to the caller
+static void become(Node *n, int kind) {
+    n->kind = kind;
+    n->op = 0;
+    n->sym = -1;
+    n->decl = -1;
+    n->a = n->b = NULL;
+}
+
+static void set_int(Node *n, long long i) {
+    become(n, N_INT);
+    n->v.i = i;
+}
+
+static void set_real(Node *n, double r) {
+    become(n, N_REAL);
+    n->v.r = r;
+}
+
+static void set_bool(Node *n, int b) {
+    become(n, N_BOOL);
+    n->v.i = b;
+}
+
+// a op b on ints into r; 0 if it overflows or divides by zero
+static int int_op(int op, long long a, long long b, long long *r) {
+    switch (op) {
+    case '+': return !__builtin_add_overflow(a, b, r);
+    case '-': return !__builtin_sub_overflow(a, b, r);
+    case '*': return !__builtin_mul_overflow(a, b, r);
+    case '/':
+    case '%':
+        if (b == 0 || (a == LLONG_MIN && b == -1)) return 0;
+        *r = op == '/' ? a / b : a % b;
+        return 1;
+    }
+    return 0;
+}
+
+// Whether comparison op holds given how its operands compare; all three
+// are 0 for a NaN, as in C
+static int holds(int op, int lt, int eq, int gt) {
+    switch (op) {
+    case '<': return lt;
+    case '>': return gt;
+    case LE: return lt || eq;
+    case GE: return gt || eq;
+    case EQ: return eq;
+    default: return !eq;
+    }
+}
+
+static void compare(Node *n, const Node *a, const Node *b) {
+    if (a->kind == N_INT && b->kind == N_INT) {
+        set_bool(n, holds(n->op, a->v.i < b->v.i, a->v.i == b->v.i, a->v.i > b->v.i));
+    } else if (a->kind == N_STRING && b->kind == N_STRING) {
+        int c = strcmp(a->v.s, b->v.s);
+        set_bool(n, holds(n->op, c < 0, c == 0, c > 0));
+    } else if (a->kind == N_BOOL && b->kind == N_BOOL) {
+        set_bool(n, holds(n->op, 0, a->v.i == b->v.i, 0));
+    } else if (a->kind != N_STRING && a->kind != N_BOOL && b->kind != N_STRING &&
+               b->kind != N_BOOL) {
+        double x = real(a), y = real(b);
+        set_bool(n, holds(n->op, x < y, x == y, x > y));
+    }
+}
+
+static void binary(Node *n) {
+    Node *a = n->a, *b = n->b;
+    if (n->op == AND || n->op == OR) {
+        // The left operand alone can settle it: false && x, true || x
+        // are their left operand, true && x and false || x are x
+        if (a->kind != N_BOOL) return;
+        if (a->v.i == (n->op == OR)) {
+            set_bool(n, a->v.i);
+        } else {
+            Node *next = n->next;
+            *n = *b;
+            n->next = next;
+        }
+        return;
+    }
+    if (!literal(a) || !literal(b)) return;
+    switch (n->op) {
+    case '+': case '-': case '*': case '/': case '%':
+        if (n->type == TY_INT) {
+            long long r;
+            if (a->kind == N_INT && b->kind == N_INT && int_op(n->op, a->v.i, b->v.i, &r))
+                set_int(n, r);
+        } else if (n->type == TY_DOUBLE) {
+            double x = real(a), y = real(b);
+            if (n->op == '/' && y == 0) return;
+            set_real(n, n->op == '+' ? x + y : n->op == '-' ? x - y : n->op == '*' ? x * y : x / y);
+        }
+        break;
+    default:
+        compare(n, a, b);
+        break;
+    }
+}
+
+static void unary(Node *n) {
+    Node *a = n->a;
+    if (n->op == '!' && a->kind == N_BOOL) set_bool(n, !a->v.i);
+    else if (n->op == '-' && a->kind == N_INT && a->v.i != LLONG_MIN) set_int(n, -a->v.i);
+    else if (n->op == '-' && a->kind == N_REAL) set_real(n, -a->v.r);
+}
+
+// Make literal n one of type t, as assigning it would convert it; 0 if no
+// literal has that type
+static int coerce(Node *n, int t) {
+    switch (t) {
+    case TY_INT: return n->kind == N_INT;
+    case TY_BOOL: return n->kind == N_BOOL;
+    case TY_STRING: return n->kind == N_STRING;
+    case TY_DOUBLE:
+        if (n->kind == N_INT) {
+            n->kind = N_REAL;
+            n->v.r = (double)n->v.i;
+        }
+        return n->kind == N_REAL;
+    default:
+        return 0;
+    }
+}
+
+void fold(Node *n) {
+    switch (n->kind) {
+    case N_BINARY:
+        if (n->type != T_ERROR) binary(n);
+        break;
+    case N_UNARY:
+        if (n->type != T_ERROR) unary(n);
+        break;
+    case N_NAME:
+        if (n->decl >= 0 && syms.value[n->decl]) {
+            const Node *lit = syms.value[n->decl];
+            become(n, lit->kind);
+            n->v = lit->v;
+        }
+        break;
+    case N_VAR:
+        if ((n->flags & F_CONST) && n->decl >= 0 && n->a && literal(n->a) && coerce(n->a, n->op))
+            syms.value[n->decl] = n->a;
+        break;
+    }
+}
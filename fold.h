@@ -0,0 +1,15 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+#include "ast.h"
+
+// Constant folding and const propagation, one node at a time as the type
+// checker finishes it, so a node's operands are folded before it is. An
+// operator whose operands are literals becomes the literal it evaluates to,
+// && and || also when only the left one is; a const whose initializer folds
+// to a literal of its type records it in syms.value, and names of it become
+// copies of that literal. Integer operations that overflow and division by
+// zero are left to run time.
+void fold(Node *n);
+
+#endif
@@ -0,0 +1,343 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "incr.h"
+#include "mem.h"
+#include "phase.h"
+
+// Growable token array
+typedef struct {
+    Token *t;
+    int n;
+    int cap;
+} Tokens;
+
+static void push(Tokens *v, Token t) {
+    if (v->n == v->cap) {
+        v->cap = v->cap ? v->cap * 2 : 256;
+        v->t = mem_realloc(v->t, v->cap * sizeof(Token));
+    }
+    v->t[v->n++] = t;
+}
+
+// Scratch arrays shared by every edit
+static Tokens merged, old;
+
+static void doc_reserve(Doc *d, int n) {
+    if (n <= d->cap) return;
+    while (d->cap < n) d->cap = d->cap ? d->cap * 2 : 64;
+    d->items = mem_realloc(d->items, d->cap * sizeof(Item));
+}
+
+static int count_lines(const char *s, int len) {
+    int n = 0;
+    for (const char *p = s; (p = memchr(p, '\n', s + len - p)) != NULL; p++) n++;
+    return n;
+}
+
+static void item_free(Item *it) {
+    mem_free(it->text);
+    mem_free(it->tokens);
+}
+
+// Append the old tokens of an item, moved to region coordinates
+static void gather(Tokens *v, const Item *it, int off, int line) {
+    for (int k = 0; k < it->ntokens; k++) {
+        Token t = it->tokens[k];
+        t.off += off;
+        t.line += line;
+        push(v, t);
+    }
+}
+
+// Cut region tokens into items at top-level ';' and '}'; whatever follows the
+// last one becomes a trailing item of its own
+static void split(const char *region, int len, int line, const Tokens *v,
+                  Item **out, int *nout) {
+    int depth = 0, from = 0, first = 0, cap = 0, base = line;
+    *out = NULL;
+    *nout = 0;
+    for (int i = 0; i <= v->n; i++) {
+        int end;
+        if (i < v->n) {
+            int k = v->t[i].kind;
+            if (k == '{') depth++;
+            else if (k == '}' && depth > 0) depth--;
+            if ((k != ';' && k != '}') || depth != 0) continue;
+            end = v->t[i].off + 1;
+        } else {
+            // Trailing blank space or an unfinished item
+            if (from == len && *nout > 0) break;
+            end = len;
+        }
+        if (*nout == cap) {
+            cap = cap ? cap * 2 : 8;
+            *out = mem_realloc(*out, cap * sizeof(Item));
+        }
+        Item *it = &(*out)[(*nout)++];
+        int count = (i < v->n ? i + 1 : v->n) - first;
+        it->len = end - from;
+        it->text = mem_alloc(it->len + 2);
+        memcpy(it->text, region + from, it->len);
+        it->text[it->len] = it->text[it->len + 1] = '\0';
+        it->line = line;
+        it->newlines = count_lines(it->text, it->len);
+        it->tokens = mem_alloc((count + 1) * sizeof(Token));
+        it->ntokens = count;
+        it->scan_errors = 0;
+        for (int t = 0; t < count; t++) {
+            it->tokens[t] = v->t[first + t];
+            it->tokens[t].off -= from;
+            it->tokens[t].line -= line - base;
+            if (it->tokens[t].kind == TRIVIA) it->scan_errors += it->tokens[t].val.ival;
+        }
+        it->tokens[count] = (Token){ .kind = 0, .off = it->len, .line = 1 + it->newlines };
+        it->nodes = NULL;
+        it->errors = 0;
+        line += it->newlines;
+        from = end;
+        first = i + 1;
+    }
+}
+
+static void parse_item(Item *it) {
+    PHASE_PUSH(PH_PARSE);
+    it->nodes = parse_tokens(it->text, it->tokens, it->ntokens, it->line - 1, &it->errors);
+    PHASE_POP();
+}
+
+void doc_open(Doc *d, const char *text, int len) {
+    char *region = mem_alloc(len + 2);
+    memcpy(region, text, len);
+    region[len] = region[len + 1] = '\0';
+    memset(d, 0, sizeof(Doc));
+    Token *t = NULL;
+    int cap = 0;
+    Tokens v = { NULL, 0, 0 };
+    PHASE_PUSH(PH_SCAN);
+    v.n = scan_tokens(region, len, SCAN_INITIAL, 1, &t, &cap);
+    PHASE_POP();
+    v.t = t;
+    Item *items;
+    int n;
+    split(region, len, 1, &v, &items, &n);
+    mem_free(t);
+    mem_free(region);
+    d->items = items;
+    d->n = d->cap = n;
+    d->len = len;
+    for (int i = 0, start = 0; i < n; i++) {
+        d->items[i].start = start;
+        start += d->items[i].len;
+        parse_item(&d->items[i]);
+    }
+}
+
+// Item holding byte off; the last item for off == document length
+static int find(const Doc *d, int off) {
+    int lo = 0, hi = d->n - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (d->items[mid].start <= off) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+
+// Newlines removed by deleting [off, off+del) from items i..j
+static int deleted_lines(const Doc *d, int i, int j, int off, int del) {
+    int n = 0;
+    for (int k = i; k <= j; k++) {
+        const Item *it = &d->items[k];
+        int from = off > it->start ? off - it->start : 0;
+        int to = off + del < it->start + it->len ? off + del - it->start : it->len;
+        if (to > from) n += count_lines(it->text + from, to - from);
+    }
+    return n;
+}
+
+// Could the region end cut a token short? The region ends on an item's
+// closing ';' or '}', but the line goes on into the next item: a string may
+// close there, and a "//" comment only matches together with its newline.
+// Either way the region has to take in the next item before scanning.
+static int cut_short(const Doc *d, int j, const char *region, int len) {
+    for (int c = len - 1; c > 0 && region[c] != '\n'; c--)
+        if (region[c] == '/' && region[c - 1] == '/') return 1;
+    for (int k = j + 1; k < d->n; k++) {
+        const Item *it = &d->items[k];
+        for (int c = 0; c < it->len; c++) {
+            if (it->text[c] == '\n') return 0;
+            if (it->text[c] == '"') return 1;
+        }
+    }
+    return 0;
+}
+
+// Take item j+1 into the region
+static void grow(const Doc *d, int *j, char **region, int *len) {
+    const Item *next = &d->items[++*j];
+    *region = mem_realloc(*region, *len + next->len + 2);
+    memcpy(*region + *len, next->text, next->len);
+    *len += next->len;
+    (*region)[*len] = (*region)[*len + 1] = '\0';
+}
+
+// Replace [off, off+del) with ins.
+//
+// Relexing restarts at the start of the edited line, in the start condition
+// recorded on the first token there (nothing in this language looks ahead
+// past a newline), and stops at the first token past the edit that lines up
+// with an old token of the same kind, length and start condition: from there
+// on the old stream is still valid. Only the items the new token run covers
+// are cut again and reparsed. Returns how many items were reparsed.
+int doc_edit(Doc *d, int off, int del, const char *ins, int ins_len) {
+    PHASE_PUSH(PH_EDIT);
+    int i = find(d, off);
+    int j = del > 0 ? find(d, off + del - 1) : i;
+    int shift = ins_len - del;
+    int line_shift = count_lines(ins, ins_len) - deleted_lines(d, i, j, off, del);
+
+    // Restart point: start of the edited line, which may lie in an earlier
+    // item, or the last token before it
+    Item *a = &d->items[i];
+    int ro = off - a->start;
+    for (;;) {
+        while (ro > 0 && a->text[ro - 1] != '\n') ro--;
+        if (ro > 0 || i == 0 || a[-1].text[a[-1].len - 1] == '\n') break;
+        a = &d->items[--i];
+        ro = a->len;
+    }
+    int head = off - a->start, r = 0;
+    while (r < a->ntokens && a->tokens[r].off < ro) r++;
+    int rstate = SCAN_INITIAL;
+    if (r < a->ntokens) {
+        rstate = a->tokens[r].state;
+    } else if (r > 0) {
+        r--;
+        ro = a->tokens[r].off;
+        rstate = a->tokens[r].state;
+    }
+    int rline = 1 + count_lines(a->text, ro);
+
+    // Region: items i..j with the edit applied; old tokens of the same span
+    Item *b = &d->items[j];
+    int tail = b->start + b->len - (off + del);
+    int len = head + ins_len + tail;
+    char *region = mem_alloc(len + 2);
+    for (int k = i, at = 0; at < head; k++) {
+        const Item *it = &d->items[k];
+        int n = it->len < head - at ? it->len : head - at;
+        memcpy(region + at, it->text, n);
+        at += n;
+    }
+    memcpy(region + head, ins, ins_len);
+    memcpy(region + head + ins_len, b->text + b->len - tail, tail);
+    region[len] = region[len + 1] = '\0';
+    // With nothing left of item j the region no longer ends on its ';' or '}'
+    if (tail == 0 && j + 1 < d->n) grow(d, &j, &region, &len);
+    while (j + 1 < d->n && cut_short(d, j, region, len)) grow(d, &j, &region, &len);
+    old.n = 0;
+    for (int k = i; k <= j; k++)
+        gather(&old, &d->items[k], d->items[k].start - a->start, d->items[k].line - a->line);
+
+    int p, synced;
+    for (;;) {
+        Token t;
+        PHASE_PUSH(PH_SCAN);
+        scan_begin(region + ro, len - ro, rstate, rline);
+        merged.n = 0;
+        for (int k = 0; k < r; k++) push(&merged, a->tokens[k]);
+        p = 0;
+        synced = 0;
+        while (scan_next(&t)) {
+            t.off += ro;
+            if (t.off >= head + ins_len) {
+                int was = t.off - shift;
+                while (p < old.n && old.t[p].off < was) p++;
+                if (p < old.n && old.t[p].off == was && old.t[p].kind == t.kind &&
+                    old.t[p].len == t.len && old.t[p].state == t.state) {
+                    synced = 1;
+                    break;
+                }
+            }
+            push(&merged, t);
+        }
+        scan_stop();
+        PHASE_POP();
+        if (synced || scan_state() == SCAN_INITIAL || j + 1 >= d->n) break;
+
+        // A comment is still open at the end of the region: take in at
+        // least as much again and rescan, so a comment left open to the end
+        // of the document costs a constant number of passes over it
+        int want = 2 * len;
+        do {
+            grow(d, &j, &region, &len);
+            gather(&old, &d->items[j], d->items[j].start - a->start, d->items[j].line - a->line);
+        } while (j + 1 < d->n && (len < want || cut_short(d, j, region, len)));
+    }
+    if (synced) {
+        for (; p < old.n; p++) {
+            Token t = old.t[p];
+            t.off += shift;
+            t.line += line_shift;
+            push(&merged, t);
+        }
+    }
+
+    // Recut; an item left open takes in the following items' tokens as is
+    int depth = 0, done = 1, k = 0;
+    for (;;) {
+        for (; k < merged.n; k++) {
+            int kind = merged.t[k].kind;
+            if (kind == '{') depth++;
+            else if (kind == '}' && depth > 0) depth--;
+            done = (kind == ';' || kind == '}') && depth == 0;
+        }
+        if (done || j + 1 >= d->n) break;
+        int at = len;
+        grow(d, &j, &region, &len);
+        old.n = 0;
+        gather(&old, &d->items[j], at, d->items[j].line + line_shift - a->line);
+        for (int t = 0; t < old.n; t++) push(&merged, old.t[t]);
+    }
+    Item *items;
+    int n;
+    split(region, len, a->line, &merged, &items, &n);
+    mem_free(region);
+
+    int start = a->start;
+    for (int k = i; k <= j; k++) item_free(&d->items[k]);
+    for (int k = 0; k < n; k++) {
+        items[k].start = start;
+        start += items[k].len;
+        parse_item(&items[k]);
+    }
+
+    // Splice the new items in and shift everything after them
+    int removed = j - i + 1;
+    doc_reserve(d, d->n - removed + n);
+    memmove(&d->items[i + n], &d->items[j + 1], (d->n - j - 1) * sizeof(Item));
+    memcpy(&d->items[i], items, n * sizeof(Item));
+    mem_free(items);
+    d->n += n - removed;
+    for (int k = i + n; k < d->n; k++) {
+        d->items[k].start += shift;
+        d->items[k].line += line_shift;
+    }
+    d->len += shift;
+    PHASE_POP();
+    return n;
+}
+
+int doc_errors(const Doc *d) {
+    int errs = 0;
+    for (int i = 0; i < d->n; i++) errs += d->items[i].errors + d->items[i].scan_errors;
+    return errs;
+}
+
+void doc_close(Doc *d) {
+    for (int i = 0; i < d->n; i++) item_free(&d->items[i]);
+    mem_free(d->items);
+    memset(d, 0, sizeof(Doc));
+}
@@ -0,0 +1,35 @@
+#ifndef INCR_H
+#define INCR_H
+
+#include "ast.h"
+#include "token.h"
+
+// A top-level item: a declaration or function plus the blank space and
+// comments before it. Items tile the document, so an edit only rescans and
+// reparses the items it touches; the rest keep their tokens and subtrees.
+typedef struct {
+    char *text;     // owned copy followed by two NUL bytes
+    int len;
+    int start;      // byte offset in the document
+    int line;       // document line of text[0]
+    int newlines;
+    Token *tokens;  // offsets relative to text, lines relative to line
+    int ntokens;
+    Node *nodes;    // top-level nodes, lines relative to line
+    int errors;     // syntax errors
+    int scan_errors; // unknown characters
+} Item;
+
+typedef struct {
+    Item *items;
+    int n;
+    int cap;
+    int len;        // document length in bytes
+} Doc;
+
+void doc_open(Doc *d, const char *text, int len);
+int doc_edit(Doc *d, int off, int del, const char *ins, int ins_len);
+int doc_errors(const Doc *d);
+void doc_close(Doc *d);
+
+#endif
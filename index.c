@@ -0,0 +1,118 @@
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "index.h"
+#include "mem.h"
+
+#define BLOCK 64
+
+// Bit i of *structural is set when p[i] is one of " / { } ;, bit i of
+// *newline when it is a newline
+static void classify(const char *p, uint64_t *structural, uint64_t *newline) {
+    uint64_t s = 0, nl = 0;
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"'), slash = _mm_set1_epi8('/');
+    const __m128i open = _mm_set1_epi8('{'), close = _mm_set1_epi8('}');
+    const __m128i semi = _mm_set1_epi8(';'), eol = _mm_set1_epi8('\n');
+    for (int k = 0; k < BLOCK; k += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + k));
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, slash)),
+                                 _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, open),
+                                                           _mm_cmpeq_epi8(v, close)),
+                                              _mm_cmpeq_epi8(v, semi)));
+        s |= (uint64_t)(uint16_t)_mm_movemask_epi8(m) << k;
+        nl |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, eol)) << k;
+    }
+#else
+    for (int k = 0; k < BLOCK; k++) {
+        char c = p[k];
+        s |= (uint64_t)(c == '"' || c == '/' || c == '{' || c == '}' || c == ';') << k;
+        nl |= (uint64_t)(c == '\n') << k;
+    }
+#endif
+    *structural = s;
+    *newline = nl;
+}
+
+// End of the string literal opening at p, by the scanner's longest match:
+// "" inside stands for a quote and a string never spans lines. Without a
+// closing quote the quote alone is an unknown character, so p + 1.
+static size_t string_end(const char *t, size_t p, size_t len) {
+    size_t end = p + 1;
+    for (size_t i = p + 1; i < len && t[i] != '\n'; i++) {
+        if (t[i] != '"') continue;
+        end = i + 1;
+        if (i + 1 < len && t[i + 1] == '"') i++;   // a quote, or the end
+        else break;
+    }
+    return end;
+}
+
+// End of the block comment opening at p; an open comment runs to the end
+static size_t comment_end(const char *t, size_t p, size_t len) {
+    for (const char *s = t + p + 2, *e = t + len; (s = memchr(s, '*', e - s)) != NULL; s++)
+        if (s + 1 < e && s[1] == '/') return s + 2 - t;
+    return len;
+}
+
+static void add(Cut **out, int *cap, int n, int end, int line) {
+    if (n == *cap) {
+        *cap = *cap ? *cap * 2 : 256;
+        *out = mem_realloc(*out, *cap * sizeof(Cut));
+    }
+    (*out)[n].end = end;
+    (*out)[n].line = line;
+}
+
+int index_items(const char *text, size_t len, Cut **out, int *cap) {
+    int n = 0, depth = 0, lines = 1;    // lines: line of the block's first byte
+    size_t next = 0;                    // bytes before next are already skipped
+    size_t no_newline = len;            // no newline follows this offset
+    char tail[BLOCK];
+    for (size_t base = 0; base < len; base += BLOCK) {
+        const char *p = text + base;
+        if (len - base < BLOCK) {
+            memset(tail, 0, BLOCK);
+            memcpy(tail, p, len - base);
+            p = tail;
+        }
+        uint64_t s, nl;
+        classify(p, &s, &nl);
+        if (next >= base + BLOCK) s = 0;
+        for (; s; s &= s - 1) {
+            int i = __builtin_ctzll(s);
+            size_t at = base + i;
+            if (at < next) continue;
+            switch (text[at]) {
+            case '"':
+                next = string_end(text, at, len);
+                break;
+            case '/':
+                // Without a newline to end it, // is two divisions
+                if (at + 1 < len && text[at + 1] == '*') {
+                    next = comment_end(text, at, len);
+                } else if (at + 1 < len && text[at + 1] == '/' && at < no_newline) {
+                    const char *e = memchr(text + at + 2, '\n', len - at - 2);
+                    if (e) next = e + 1 - text;
+                    else no_newline = at;
+                }
+                break;
+            case '{':
+                depth++;
+                break;
+            case '}':
+                if (depth > 0) depth--;
+                // fall through
+            case ';':
+                if (depth == 0)
+                    add(out, cap, n++, at + 1, lines + __builtin_popcountll(nl & ((1ULL << i) - 1)));
+                break;
+            }
+        }
+        lines += __builtin_popcountll(nl);
+    }
+    return n;
+}
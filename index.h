@@ -0,0 +1,20 @@
+#ifndef INDEX_H
+#define INDEX_H
+
+#include <stddef.h>
+
+// Structural pre-index, in the style of simdjson's first stage: a vector
+// pass turns every 64-byte block into a bitmask of the bytes that can matter
+// for structure (quotes, slashes, braces, semicolons), and a scalar pass
+// visits only those bits, skipping strings and comments the way the scanner
+// does. An item ends after a ';' or '}' outside every brace, the same cut
+// incr.c makes from tokens.
+typedef struct {
+    int end;        // offset just past the item
+    int line;       // line the text after it starts on
+} Cut;
+
+// Cuts of text[0..len) in order, into *out grown as needed; returns the count
+int index_items(const char *text, size_t len, Cut **out, int *cap);
+
+#endif
@@ -541,80 +541,176 @@ char *yytext;
 #include <string.h>
 #include <ctype.h>
 
+#include "ast.h"
 #include "y.tab.h" // for token return by yacc
+#include "token.h"
+#include "mem.h"
+#include "profile.h"
+#include "cache.h"
+
+// yylex() lives in parser.y and pulls tokens from here
+#define YY_DECL int scan(void)
+
+// Byte offset just past the last match, for token positions; instrumented
+// builds also count the rule that matched
+#ifdef PROFILE
+#define YY_USER_ACTION scan_offset += yyleng; rule_hits[yy_act]++;
+#else
+#define YY_USER_ACTION scan_offset += yyleng;
+#endif
 
 #define MAX_LINE_LENG 256
 #define MAX_ID_LEN 64
-#define MAX_SYMBOLS 1000
-#define HASH_SIZE 211
-
-#define LIST strcat(buf, yytext)
-
-// Print macros
-#ifdef DEBUG
-#define token(t) {LIST; printf("<%s>\n", t);}
-#define tokenInteger(t, s) {LIST; printf("<%s: %s>\n", t, s);}
-#define tokenString(t, s) {LIST; printf("<%s: %s>\n", t, s);}
-// Add '' to op and delim
-#define tokenOp(d) {LIST; printf("<'%s'>\n", d);}
-#define tokenDelim(d) {LIST; printf("<'%s'>\n", d);}
-#else
-#define token(t) {}
-#define tokenInteger(t, s) {}
-#define tokenString(t, s) {}
-#define tokenOp(d) {}
-#define tokenDelim(d) {}
-#endif
+#define HASH_SIZE 211   // initial slot count; the table doubles at half full
 
-// Symbol Table
-char* symbolTable[HASH_SIZE];
+#define LIST if (listing) strcat(buf, yytext)
+
+// Symbol Table: names by dense symbol id, plus an open-addressed index of
+// slots holding id + 1 (0 = empty)
+char **symbolTable = NULL;
+int nsymbols = 0;
+static int *slots = NULL;
+static unsigned int nslots = 0;
 int linenum = 1;
+YYSTYPE yylval;
 char buf[MAX_LINE_LENG];
+int scan_offset = 0;
+int listing = 1;    // echo comment lines as they are scanned
+int trivia = 0;     // also return comments, one TRIVIA token per line
+static int unknown; // the TRIVIA token is an unknown character
+int defer_strings = 0;  // leave string values to the parser (--pipeline)
+extern int errors;
+
+#ifdef PROFILE
+// Matches per rule, indexed like yy_act: rules in the order they appear
+// below, then the default ECHO rule
+static long rule_hits[YY_NUM_RULES + 1];
+static const char *rule_names[YY_NUM_RULES + 1] = {
+    "", "comment //", "comment /*", "comment */", "comment newline",
+    "comment text", "REAL", "INT", "STRING", "KEYWORD", "ID", "OP", "DELIM",
+    "whitespace", "newline", "unknown", "default"
+};
+#endif
 
-// Hash function
+// Hash function: FNV-1a, so short names still spread over a large table
 unsigned int hash(char *s) {
-    unsigned int h = 0;
-    for (; *s; s++) h = (h << 4) + *s;
-    return h % HASH_SIZE;
+    unsigned int h = 2166136261u;
+    for (; *s; s++) h = (h ^ (unsigned char)*s) * 16777619u;
+    return h;
 }
 
 void create() {
-    for (int i = 0; i < HASH_SIZE; i++) symbolTable[i] = NULL;
+    for (int i = 0; i < nsymbols; i++) mem_free(symbolTable[i]);
+    mem_free(symbolTable);
+    mem_free(slots);
+    symbolTable = NULL;
+    slots = NULL;
+    nsymbols = nslots = 0;
+}
+
+// Slot holding s, or the empty slot where it belongs
+static unsigned int probe(char *s) {
+    unsigned int i = hash(s) % nslots;
+    while (slots[i] != 0 && strcmp(symbolTable[slots[i] - 1], s) != 0)
+        if (++i == nslots) i = 0;
+    return i;
+}
+
+// Double the slots and re-index every name; ids never change
+static void grow() {
+    mem_free(slots);
+    nslots = nslots ? nslots * 2 : HASH_SIZE;
+    slots = mem_calloc(nslots, sizeof(int));
+    symbolTable = mem_realloc(symbolTable, nslots / 2 * sizeof(char *));
+    for (int id = 0; id < nsymbols; id++) slots[probe(symbolTable[id])] = id + 1;
 }
 
 int lookup(char *s) {
-    unsigned int i = hash(s);
-    int start = i;
-    while (symbolTable[i] != NULL) {
-        if (strcmp(symbolTable[i], s) == 0) return i;
-        i = (i + 1) % HASH_SIZE;
-        if (i == start) break;
-    }
-    return -1;
+    if (nslots == 0) return -1;
+    return slots[probe(s)] - 1;
 }
 
 int insert(char *s) {
-    unsigned int i = hash(s);
-    int start = i;
-    while (symbolTable[i] != NULL) {
-        if (strcmp(symbolTable[i], s) == 0) return i;
-        i = (i + 1) % HASH_SIZE;
-        if (i == start) break;
+    if (2 * (nsymbols + 1) > (int)nslots) grow();
+    unsigned int i = probe(s);
+    if (slots[i] == 0) {
+        symbolTable[nsymbols] = mem_strdup(s);
+        slots[i] = ++nsymbols;
     }
-    symbolTable[i] = strdup(s);
-    return i;
+    return slots[i] - 1;
+}
+
+// Keyword text to token; type keywords share TYPE with the type in yylval
+int keyword(const char *s) {
+    switch (s[0]) {
+    case 'b':
+        if (s[1] == 'o') { yylval.type = TY_BOOL; return TYPE; }
+        return BREAK;
+    case 'c':
+        if (s[1] == 'h') { yylval.type = TY_CHAR; return TYPE; }
+        if (s[1] == 'a') break;
+        return s[3] == 's' ? CONST : CONTINUE;
+    case 'd':
+        if (s[2] == 'u') { yylval.type = TY_DOUBLE; return TYPE; }
+        break;
+    case 'e':
+        if (s[1] == 'l') return ELSE;
+        break;
+    case 'f':
+        if (s[1] == 'a') return FALSE;
+        if (s[1] == 'l') { yylval.type = TY_FLOAT; return TYPE; }
+        return s[3] == 'e' ? FOREACH : FOR;
+    case 'i':
+        if (s[1] == 'f') return IF;
+        yylval.type = TY_INT;
+        return TYPE;
+    case 'p': return s[5] == 'l' ? PRINTLN : PRINT;
+    case 'r': return s[2] == 'a' ? READ : RETURN;
+    case 's':
+        if (s[2] == 'r') { yylval.type = TY_STRING; return TYPE; }
+        break;
+    case 't': return TRUE;
+    case 'v': yylval.type = TY_VOID; return TYPE;
+    case 'w': return WHILE;
+    }
+    // case default do extern switch: reserved, no statement uses them yet
+    return KEYWORD;
+}
+
+// Operator text to token; single characters are their own token
+int op(const char *s) {
+    if (s[1] == '\0') return s[0];
+    switch (s[0]) {
+    case '+': return INC;
+    case '-': return DEC;
+    case '=': return EQ;
+    case '!': return NE;
+    case '<': return LE;
+    case '>': return GE;
+    case '|': return OR;
+    default: return AND;
+    }
+}
+
+// String literal value: quotes stripped, "" collapsed to "
+char *string_value(const char *s, int len) {
+    char *v = ast_alloc(len);
+    int n = 0;
+    for (int i = 1; i < len - 1; i++) {
+        v[n++] = s[i];
+        if (s[i] == '"') i++;
+    }
+    v[n] = '\0';
+    return v;
 }
 
 void dump() {
     printf("Symbol Table:\n");
-    for (int i = 0; i < HASH_SIZE; i++) {
-        if (symbolTable[i] != NULL)
-            printf("%s\n", symbolTable[i]);
-    }
+    for (int i = 0; i < nsymbols; i++) printf("%s\n", symbolTable[i]);
 }
-#line 615 "lex.yy.c"
+#line 711 "lex.yy.c"
 
-#line 617 "lex.yy.c"
+#line 713 "lex.yy.c"
 
 #define INITIAL 0
 #define COMMENT 1
@@ -832,9 +928,9 @@ YY_DECL
 		}
 
 	{
-#line 91 "scanner.l"
+#line 188 "scanner.l"
 
-#line 837 "lex.yy.c"
+#line 933 "lex.yy.c"
 
 	while ( /*CONSTCOND*/1 )		/* loops until end-of-file is reached */
 		{
@@ -894,44 +990,48 @@ do_action:	/* This label is used only to access EOF actions. */
 case 1:
 /* rule 1 can match eol */
 YY_RULE_SETUP
-#line 92 "scanner.l"
+#line 189 "scanner.l"
 {    // single line comment
-    printf("%d: %s", linenum, yytext);
+    if (listing) printf("%d: %s", linenum, yytext);
     linenum++;
     buf[0] = '\0';
+    if (trivia) return TRIVIA;
 }
 	YY_BREAK
 case 2:
 YY_RULE_SETUP
-#line 98 "scanner.l"
+#line 196 "scanner.l"
 {      // multi line comment
     BEGIN(COMMENT);
     LIST;
+    if (trivia) return TRIVIA;
 }
 	YY_BREAK
 
 case 3:
 YY_RULE_SETUP
-#line 103 "scanner.l"
+#line 202 "scanner.l"
 {
         LIST;
         BEGIN(INITIAL);
+        if (trivia) return TRIVIA;
     }
 	YY_BREAK
 case 4:
 /* rule 4 can match eol */
 YY_RULE_SETUP
-#line 107 "scanner.l"
+#line 207 "scanner.l"
 {
         LIST;
-        printf("%d: %s\n", linenum, buf);
+        if (listing) printf("%d: %s\n", linenum, buf);
         linenum++;
         buf[0] = '\0';
+        if (trivia) return TRIVIA;
     }
 	YY_BREAK
 case 5:
 YY_RULE_SETUP
-#line 113 "scanner.l"
+#line 214 "scanner.l"
 {
         LIST;
     }
@@ -939,61 +1039,68 @@ YY_RULE_SETUP
 
 case 6:
 YY_RULE_SETUP
-#line 118 "scanner.l"
-{tokenString("REAL", yytext); return REAL;}
+#line 219 "scanner.l"
+{if (!check_only) yylval.rval = atof(yytext); return REAL;}
 	YY_BREAK
 case 7:
 YY_RULE_SETUP
-#line 119 "scanner.l"
-{tokenInteger("INT", yytext); return INT;}
+#line 220 "scanner.l"
+{if (!check_only) yylval.ival = atoll(yytext); return INT;}
 	YY_BREAK
 case 8:
 YY_RULE_SETUP
-#line 120 "scanner.l"
-{tokenString("STRING", yytext); return STRING;}
+#line 221 "scanner.l"
+{if (!check_only && !defer_strings) yylval.sval = string_value(yytext, yyleng); return STRING;}
 	YY_BREAK
 case 9:
 YY_RULE_SETUP
-#line 121 "scanner.l"
-{token("KEYWORD"); return KEYWORD;}
+#line 222 "scanner.l"
+{return keyword(yytext);}
 	YY_BREAK
 case 10:
 YY_RULE_SETUP
-#line 122 "scanner.l"
-{if (lookup(yytext) == -1) insert(yytext); tokenString("ID", yytext); return ID;}
+#line 223 "scanner.l"
+{if (!check_only) yylval.sym = insert(yytext); return ID;}
 	YY_BREAK
 case 11:
 YY_RULE_SETUP
-#line 123 "scanner.l"
-{tokenOp(yytext); return OP;}
+#line 224 "scanner.l"
+{return op(yytext);}
 	YY_BREAK
 case 12:
 YY_RULE_SETUP
-#line 124 "scanner.l"
-{tokenDelim(yytext); return DELIM;}
+#line 225 "scanner.l"
+{return yytext[0];}
 	YY_BREAK
 case 13:
 YY_RULE_SETUP
-#line 125 "scanner.l"
+#line 226 "scanner.l"
 ;    // ignore whitespace
 	YY_BREAK
 case 14:
 /* rule 14 can match eol */
 YY_RULE_SETUP
-#line 126 "scanner.l"
+#line 227 "scanner.l"
 {linenum++;} // increment line number
 	YY_BREAK
 case 15:
 YY_RULE_SETUP
-#line 127 "scanner.l"
-{fprintf(stderr, "Unknown character: '%s'\n", yytext); exit(1);}
+#line 228 "scanner.l"
+{
+    diag("Unknown character: '%s' at line %d\n", yytext, linenum);
+    __atomic_add_fetch(&errors, 1, __ATOMIC_RELAXED);
+    if (trivia) {
+        unknown = 1;
+        return TRIVIA;
+    }
+}
 	YY_BREAK
 case 16:
 YY_RULE_SETUP
-#line 128 "scanner.l"
+#line 236 "scanner.l"
 ECHO;
 	YY_BREAK
-#line 996 "lex.yy.c"
+#line 1103 "lex.yy.c"
 case YY_STATE_EOF(INITIAL):
 case YY_STATE_EOF(COMMENT):
 	yyterminate();
@@ -1974,33 +2081,145 @@ static int yy_flex_strlen (const char * s )
 }
 #endif
 
-void *yyalloc (yy_size_t  size )
-{
-			return malloc(size);
+#define YYTABLES_NAME "yytables"
+
+#line 236 "scanner.l"
+
+
+// Scan text[0..len) in memory, starting in the given start condition
+void scan_buffer(char *text, size_t len, int state, int line) {
+    if (YY_CURRENT_BUFFER) yy_delete_buffer(YY_CURRENT_BUFFER);
+    yy_scan_buffer(text, len + 2);
+    BEGIN(state);
+    linenum = line;
+    scan_offset = 0;
+    trivia = 0;
 }
 
-void *yyrealloc  (void * ptr, yy_size_t  size )
-{
-		
-	/* The cast to (char *) in the following accommodates both
-	 * implementations that use char* generic pointers, and those
-	 * that use void* generic pointers.  It works with the latter
-	 * because both ANSI C and C++ allow castless assignment from
-	 * any pointer type to void*, and deal with argument conversions
-	 * as though doing an assignment.
-	 */
-	return realloc(ptr, size);
+// Start condition the scanner stopped in (COMMENT if a comment is open)
+int scan_state(void) {
+    return YY_START;
 }
 
-void yyfree (void * ptr )
-{
-			free( (char *) ptr );	/* see yyrealloc() for (char *) cast */
+// Token-at-a-time scanning for relexing. Comments come out as TRIVIA tokens
+// so every token records the start condition it began in, and scanning can
+// later resume from any of them. An unknown character, reported as it is
+// scanned, is a TRIVIA token too, with val.ival 1, so the text it lies in
+// can be known to hold an error.
+static int next_state, next_end;
+
+void scan_begin(char *text, size_t len, int state, int line) {
+    scan_buffer(text, len, state, line);
+    trivia = 1;
+    next_state = state;
+    next_end = 0;
 }
 
-#define YYTABLES_NAME "yytables"
+int scan_next(Token *k) {
+    int t = scan();
+    if (t == 0) {
+        k->kind = 0;
+        k->state = YY_START;
+        k->off = scan_offset;
+        k->len = 0;
+        k->line = linenum;
+        return 0;
+    }
+    k->kind = t;
+    k->state = next_state;
+    // Inside a comment a token spans the comment text since the last one
+    k->off = next_state == COMMENT ? next_end : scan_offset - yyleng;
+    k->len = scan_offset - k->off;
+    k->line = linenum - (yytext[yyleng - 1] == '\n');
+    k->val = yylval;
+    if (t == TRIVIA) {
+        k->val.ival = unknown;
+        unknown = 0;
+    }
+    next_end = scan_offset;
+    next_state = YY_START;
+    return t;
+}
 
-#line 128 "scanner.l"
+// Stop scanning early: flex keeps a NUL written after the last token, so put
+// the character it replaced back before anyone else reads the buffer
+void scan_stop(void) {
+    if (yy_c_buf_p) *yy_c_buf_p = yy_hold_char;
+}
 
+// Scan a whole buffer into *out, growing it as needed; returns the count
+int scan_tokens(char *text, size_t len, int state, int line, Token **out, int *cap) {
+    int n = 0;
+    scan_begin(text, len, state, line);
+    for (;;) {
+        if (n == *cap) {
+            *cap = *cap ? *cap * 2 : 256;
+            *out = mem_realloc(*out, *cap * sizeof(Token));
+        }
+        if (!scan_next(&(*out)[n])) break;
+        n++;
+    }
+    scan_stop();
+    return n;
+}
+
+// flex's buffers come from the same allocator as everything else, but for
+// --check, which takes them from static storage: the buffer stack, the
+// buffer and its YY_BUF_SIZE characters, handed out in order and given back
+// last first. Only a token longer than the buffer makes flex grow it, and
+// then onto the heap.
+#define ARENA_SIZE (YY_BUF_SIZE + 1024)
+static _Alignas(16) char arena[ARENA_SIZE];
+static size_t arena_used;
+
+static int in_arena(const void *p) {
+    return (const char *)p >= arena && (const char *)p < arena + ARENA_SIZE;
+}
+
+void *yyalloc(yy_size_t size) {
+    size_t need = (size + 15) & ~(size_t)15;
+    if (check_only && need <= ARENA_SIZE - arena_used) {
+        arena_used += need;
+        return arena + arena_used - need;
+    }
+    return mem_alloc(size);
+}
+
+void *yyrealloc(void *p, yy_size_t size) {
+    if (!in_arena(p)) return mem_realloc(p, size);
+    size_t left = arena + ARENA_SIZE - (char *)p;
+    void *q = mem_alloc(size);
+    memcpy(q, p, size < left ? size : left);
+    return q;
+}
+
+void yyfree(void *p) {
+    if (!in_arena(p)) mem_free(p);
+    else if ((size_t)((char *)p - arena) < arena_used) arena_used = (char *)p - arena;
+}
+
+#ifdef PROFILE
+static int by_hits(const void *a, const void *b) {
+    long x = rule_hits[*(const int *)a], y = rule_hits[*(const int *)b];
+    return (x < y) - (x > y);
+}
+
+void scan_profile(FILE *f) {
+    int order[YY_NUM_RULES];
+    long total = 0;
+    for (int r = 1; r <= YY_NUM_RULES; r++) {
+        order[r - 1] = r;
+        total += rule_hits[r];
+    }
+    qsort(order, YY_NUM_RULES, sizeof(int), by_hits);
+    fprintf(f, "%-16s %12s %7s\n", "scanner rule", "hits", "share");
+    for (int i = 0; i < YY_NUM_RULES; i++) {
+        long n = rule_hits[order[i]];
+        fprintf(f, "%-16s %12ld %6.2f%%\n", rule_names[order[i]], n, total ? 100.0 * n / total : 0);
+    }
+    fprintf(f, "%-16s %12ld\n", "total", total);
+}
+#endif
 
 // int main(int argc, char **argv) {
 //     create();
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "mem.h"
+#include "phase.h"
+
+int mem_report = 0;
+
+static Allocator libc = { malloc, realloc, free };
+static const Allocator *under = &libc;
+
+// Size header in front of every block, padded to keep the block aligned
+typedef union {
+    size_t size;
+    max_align_t align;
+} Header;
+
+// Per phase, plus one slot for allocations made outside every phase. The
+// counts are updated atomically, since --pipeline allocates from two threads.
+typedef struct {
+    long allocs;
+    long reallocs;
+    long frees;
+    size_t bytes;       // requested, counting only the growth of a realloc
+    size_t peak;        // highest live total seen while the phase was on top
+} Usage;
+
+static Usage use[NPHASES + 1];
+static size_t live = 0, peak = 0;
+
+static Usage *current(void) {
+    int p = phase_current();
+    return &use[p < 0 ? NPHASES : p];
+}
+
+static void *out_of_memory(void) {
+    perror("malloc");
+    exit(1);
+}
+
+#define ADD(x, n) __atomic_add_fetch(&(x), (n), __ATOMIC_RELAXED)
+
+static void raise_to(size_t *p, size_t v) {
+    size_t old = __atomic_load_n(p, __ATOMIC_RELAXED);
+    while (v > old && !__atomic_compare_exchange_n(p, &old, v, 1, __ATOMIC_RELAXED,
+                                                   __ATOMIC_RELAXED))
+        ;
+}
+
+static void grew(Usage *u, size_t n) {
+    ADD(u->bytes, n);
+    size_t now = ADD(live, n);
+    raise_to(&u->peak, now);
+    raise_to(&peak, now);
+}
+
+void *mem_alloc(size_t size) {
+    Header *h = under->alloc(sizeof(Header) + size);
+    if (h == NULL) return out_of_memory();
+    h->size = size;
+    Usage *u = current();
+    ADD(u->allocs, 1);
+    grew(u, size);
+    return h + 1;
+}
+
+void *mem_calloc(size_t n, size_t size) {
+    void *p = mem_alloc(n * size);
+    memset(p, 0, n * size);
+    return p;
+}
+
+void *mem_realloc(void *p, size_t size) {
+    if (p == NULL) return mem_alloc(size);
+    Header *h = (Header *)p - 1;
+    size_t old = h->size;
+    h = under->realloc(h, sizeof(Header) + size);
+    if (h == NULL) return out_of_memory();
+    h->size = size;
+    Usage *u = current();
+    ADD(u->reallocs, 1);
+    if (size > old) grew(u, size - old);
+    else ADD(live, -(old - size));
+    return h + 1;
+}
+
+void mem_free(void *p) {
+    if (p == NULL) return;
+    Header *h = (Header *)p - 1;
+    ADD(live, -h->size);
+    ADD(current()->frees, 1);
+    under->free(h);
+}
+
+char *mem_strdup(const char *s) {
+    size_t n = strlen(s) + 1;
+    return memcpy(mem_alloc(n), s, n);
+}
+
+void mem_set_allocator(const Allocator *a) {
+    under = a ? a : &libc;
+}
+
+void mem_stats(FILE *f, int json) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    if (json) {
+        fprintf(f, "{\"phases\": [");
+        for (int p = 0; p <= NPHASES; p++)
+            fprintf(f, "%s{\"name\": \"%s\", \"allocs\": %ld, \"reallocs\": %ld, "
+                    "\"frees\": %ld, \"bytes\": %zu, \"peak_bytes\": %zu}", p ? ", " : "",
+                    p < NPHASES ? phase_name(p) : "other", use[p].allocs, use[p].reallocs,
+                    use[p].frees, use[p].bytes, use[p].peak);
+        fprintf(f, "], \"live_bytes\": %zu, \"peak_bytes\": %zu, \"peak_rss_kb\": %ld}\n",
+                live, peak, ru.ru_maxrss);
+        return;
+    }
+    fprintf(f, "%-8s %10s %10s %10s %12s %10s\n", "phase", "allocs", "reallocs", "frees",
+            "KB", "peak KB");
+    for (int p = 0; p <= NPHASES; p++) {
+        Usage *u = &use[p];
+        if (u->allocs + u->reallocs + u->frees == 0) continue;
+        fprintf(f, "%-8s %10ld %10ld %10ld %12.1f %10.1f\n",
+                p < NPHASES ? phase_name(p) : "other", u->allocs, u->reallocs, u->frees,
+                u->bytes / 1024.0, u->peak / 1024.0);
+    }
+    fprintf(f, "live at exit %.1f KB, peak live %.1f KB, peak RSS %ld KB\n",
+            live / 1024.0, peak / 1024.0, ru.ru_maxrss);
+}
@@ -0,0 +1,32 @@
+#ifndef MEM_H
+#define MEM_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// Every front-end allocation goes through these: the symbol table, flex's
+// buffers, the parser stacks, the AST arena and the incremental document.
+// Each block carries a small header with its size, so frees can be counted
+// too; a block from mem_alloc must only ever go back to mem_free.
+void *mem_alloc(size_t size);
+void *mem_calloc(size_t n, size_t size);
+void *mem_realloc(void *p, size_t size);
+void mem_free(void *p);
+char *mem_strdup(const char *s);
+
+// The allocator underneath, malloc/realloc/free unless replaced. Replace it
+// before the first allocation; blocks are never moved between allocators.
+typedef struct {
+    void *(*alloc)(size_t size);
+    void *(*realloc)(void *p, size_t size);
+    void (*free)(void *p);
+} Allocator;
+
+void mem_set_allocator(const Allocator *a);
+
+extern int mem_report;      // 0 off, 1 table, 2 JSON
+
+// Allocations, bytes and high-water mark per phase, plus peak RSS
+void mem_stats(FILE *f, int json);
+
+#endif
@@ -0,0 +1,147 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include "parallel.h"
+#include "index.h"
+#include "token.h"
+#include "cache.h"
+#include "mem.h"
+#include "phase.h"
+
+// Parts are cut at the first item end past this many bytes. The size does
+// not depend on the number of jobs, so neither do the parts nor the output.
+#define PART_SIZE (64 * 1024)
+#define MAX_JOBS 64
+
+extern int errors, max_errors;
+
+typedef struct {
+    char *text;     // own copy followed by two NUL bytes
+    int len;
+    int line;       // line of text[0]
+    Token *tokens;  // lines are lines of the whole buffer
+    int ntokens;
+    char *scan_diags, *parse_diags;
+    size_t scan_len, parse_len;
+    Node *nodes;
+} Part;
+
+static Part *parts;
+static int nparts;
+static atomic_int scanned;      // parts ready to parse, written by the scanner
+static atomic_int claimed;      // parts handed out to parsers
+static int room;                // errors left to show before the cap
+
+static void parse_part(Part *p) {
+    int errs;
+    diag_hold();
+    p->nodes = parse_tokens(p->text, p->tokens, p->ntokens, 0, &errs);
+    p->parse_diags = diag_release(&p->parse_len);
+    mem_free(p->tokens);
+    mem_free(p->text);
+}
+
+// Print held messages, one error per line, while the cap leaves room. A
+// part stops at max_errors of its own, past where the room runs out.
+static void emit(char *text, size_t len) {
+    size_t cut = 0;
+    while (cut < len && room > 0) {
+        const char *nl = memchr(text + cut, '\n', len - cut);
+        cut = nl ? (size_t)(nl + 1 - text) : len;
+        room--;
+    }
+    diag_emit(text, cut);
+    mem_free(text);
+}
+
+// Parse parts in turn until none are left, waiting for each to be scanned
+static void parse_parts(void) {
+    int i;
+    while ((i = atomic_fetch_add(&claimed, 1)) < nparts) {
+        while (atomic_load_explicit(&scanned, memory_order_acquire) <= i) sched_yield();
+        parse_part(&parts[i]);
+    }
+}
+
+static void *worker(void *arg) {
+    (void)arg;
+    parse_parts();
+    ast_retire();
+    return NULL;
+}
+
+// Cut text into parts of at least PART_SIZE bytes; the last takes the rest
+static void cut_parts(const char *text, size_t len) {
+    Cut *cuts = NULL;
+    int cap = 0;
+    int ncuts = index_items(text, len, &cuts, &cap);
+    parts = mem_calloc(ncuts + 1, sizeof(Part));
+    nparts = 0;
+    int from = 0, line = 1;
+    for (int c = 0; c <= ncuts; c++) {
+        int end = c < ncuts ? cuts[c].end : (int)len;
+        if (c < ncuts && end - from < PART_SIZE) continue;
+        if (end == from && nparts > 0) break;
+        Part *p = &parts[nparts++];
+        p->len = end - from;
+        p->text = mem_alloc(p->len + 2);
+        memcpy(p->text, text + from, p->len);
+        p->text[p->len] = p->text[p->len + 1] = '\0';
+        p->line = line;
+        if (c < ncuts) line = cuts[c].line;
+        from = end;
+    }
+    mem_free(cuts);
+}
+
+Node *parse_parallel(const char *text, size_t len, int jobs) {
+    if (jobs > MAX_JOBS) jobs = MAX_JOBS;
+    pthread_t threads[MAX_JOBS];
+    int started = 0, before = errors;
+    PHASE_PUSH(PH_SCAN);
+    cut_parts(text, len);
+    PHASE_POP();
+    atomic_store(&scanned, 0);
+    atomic_store(&claimed, 0);
+    while (started < jobs - 1 && pthread_create(&threads[started], NULL, worker, NULL) == 0)
+        started++;
+
+    // The scanner is not reentrant, so this thread scans every part
+    PHASE_PUSH(PH_SCAN);
+    for (int i = 0; i < nparts; i++) {
+        Part *p = &parts[i];
+        int cap = 0;
+        diag_hold();
+        p->ntokens = scan_tokens(p->text, p->len, SCAN_INITIAL, p->line, &p->tokens, &cap);
+        p->scan_diags = diag_release(&p->scan_len);
+        atomic_store_explicit(&scanned, i + 1, memory_order_release);
+    }
+    PHASE_POP();
+    PHASE_PUSH(PH_PARSE);
+    parse_parts();
+    for (int t = 0; t < started; t++) pthread_join(threads[t], NULL);
+    PHASE_POP();
+
+    // Only the errors shown count, as a serial parse stops at the cap
+    List all = list_one(NULL);
+    room = max_errors > before ? max_errors - before : 0;
+    int start = room;
+    for (int i = 0; i < nparts; i++) {
+        Part *p = &parts[i];
+        emit(p->scan_diags, p->scan_len);
+        emit(p->parse_diags, p->parse_len);
+        for (Node *n = p->nodes, *next; n; n = next) {
+            next = n->next;
+            n->next = NULL;
+            all = list_add(all, n);
+        }
+    }
+    errors = before + start - room;
+    if (start > 0 && room == 0) diag("Error: too many errors, giving up\n");
+    mem_free(parts);
+    parts = NULL;
+    program = all.head;
+    return program;
+}
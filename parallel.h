@@ -0,0 +1,16 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stddef.h>
+
+#include "ast.h"
+
+// Parse a whole buffer as independent parts: the structural index cuts it
+// between top-level items into parts of similar size, this thread scans them
+// in order, and jobs threads (this one included) parse them as they come.
+// The trees are stitched back together and the diagnostics printed in
+// source order, the same whatever the number of jobs. The error cap
+// applies to the whole buffer, as in a serial parse.
+Node *parse_parallel(const char *text, size_t len, int jobs);
+
+#endif
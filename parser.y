@@ -2,104 +2,778 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+// Instrumented builds count reductions in bison's reduce step: make builds
+// them from a copy of y.tab.c with PROFILE_REDUCE after its YY_REDUCE_PRINT.
+// YYDEBUG is on only for the rule names and lines; yydebug stays 0, so no
+// trace is printed.
+#ifdef PROFILE
+#define YYDEBUG 1
+#define PROFILE_REDUCE(Rule) profile_reduce(Rule)
+static void profile_reduce(int rule);
+#endif
+
+#include "ast.h"
+#include "token.h"
+#include "incr.h"
+#include "phase.h"
+#include "mem.h"
+#include "profile.h"
+#include "trace.h"
+#include "stream.h"
+#include "cache.h"
+#include "pipeline.h"
+#include "parallel.h"
+#include "scope.h"
+#include "sema.h"
+#include "code.h"
+#include "vm.h"
 
 // get token that recognized by scanner
-extern int yylex();
+extern int scan();
 extern int yyparse();
 extern FILE *yyin;
 
 // Add a global variable to store the token text
 extern char *yytext;
+extern int yyleng;
+extern int linenum;
+// Line of the token the parser read last; the scanner's linenum may be ahead.
+// This and the rest of the parser's state are per thread, for --jobs.
+static _Thread_local int tokline = 1;
+// Parameters and variables declared since the last top-level item, which a
+// function keeps as its count of symbol ids (sema.h)
+static _Thread_local int decls;
+extern int scan_offset;
+extern char **symbolTable;
+
+// --check: accept/reject only, no tree, no symbol text, no token output
+int check_only = 0;
+int trace = 0;      // --trace FILE: record every token as it is read
+static int quiet = 0;       // --quiet: full parse, nothing echoed
+static int scan_only = 0;   // --scan-only: count tokens, no parse
+static int from_tokens = 0; // --from-tokens: the input is a token stream
+static int pipeline = 0;    // --pipeline: scan on a second thread
+static int jobs = 0;        // --jobs N: parse top-level items on N threads
+static int sema_jobs = 1;   // and analyze functions on N threads
+static int unused = 0;      // --warn-unused: report unreferenced locals
+static int run = 0;         // --run: compile and execute, nothing echoed
+extern int listing;
+
+// Pre-scanned tokens replayed instead of calling the scanner; replay_text is
+// the text their offsets point into, NULL for a token stream file
+static _Thread_local const char *replay_text;
+static _Thread_local const Token *replay, *replay_end;
+static _Thread_local int replay_base;
+
+// Syntax errors reported so far; parsing stops once the errors counted for
+// this parse reach max_errors
+int errors = 0;
+int max_errors = 20;
+static _Thread_local int *counted = &errors;
+
+// The parser stacks start at YYINITDEPTH entries and double on the heap as
+// nesting deepens; the only cap is this budget in bytes (--stack-budget)
+long stack_budget = 256L << 20;
+#define YYMAXDEPTH (stack_budget / (long) (sizeof(yy_state_t) + sizeof(YYSTYPE)))
+#define YYMALLOC mem_alloc
+#define YYFREE mem_free
+
+int yylex(YYSTYPE *lval);
 
+// The scanner may be counting errors too, on its own thread (--pipeline)
 void yyerror(const char *s) {
-    fprintf(stderr, "Error: %s\n", s);
+    int e = __atomic_add_fetch(counted, 1, __ATOMIC_RELAXED);
+    if (e > max_errors) return;
+    if (replay && replay_text == NULL) {
+        // Without the text, only names and single characters can be shown
+        const Token *t = &replay[-1];
+        char one[2] = { t->kind > 0 && t->kind < 256 ? t->kind : 0, '\0' };
+        diag("Error: %s at line %d near '%s'\n", s, replay_base + tokline,
+             t->kind == ID ? symbolTable[t->val.sym] : one);
+    } else if (replay) {
+        const Token *t = replay[-1].kind ? &replay[-1] : NULL;
+        diag("Error: %s at line %d near '%.*s'\n", s, replay_base + tokline,
+             t ? t->len : 0, t ? replay_text + t->off : "");
+    } else {
+        diag("Error: %s at line %d near '%s'\n", s, tokline, yytext);
+    }
+    if (e == max_errors)
+        diag("Error: too many errors, giving up\n");
+}
+
+// After resynchronizing: report the next error right away, unless capped
+#define RECOVER { yyerrok; if (__atomic_load_n(counted, __ATOMIC_RELAXED) >= max_errors) YYABORT; }
+
+// Declarations carry their type on every declared variable
+static List typed(List vars, int type, int flags) {
+    for (Node *n = vars.head; n; n = n->next) {
+        n->op = type;
+        n->flags |= flags;
+    }
+    return vars;
 }
 %}
 
+%define api.pure full
+
+%union {
+    long long ival;
+    double rval;
+    char *sval;
+    int sym;
+    int type;
+    Node *node;
+    List list;
+}
+
 // define token
-%token VOID MAIN IF ELSE WHILE PRINT RETURN
-%token ID INT REAL STRING OP DELIM
+%token <sym> ID
+%token <type> TYPE
+%token <ival> INT
+%token <rval> REAL
+%token <sval> STRING
+%token IF ELSE WHILE FOR FOREACH PRINT PRINTLN READ RETURN BREAK CONTINUE
+%token CONST TRUE FALSE
 %token KEYWORD
+%token TRIVIA
+%token EQ NE LE GE AND OR INC DEC
+
+%type <list> items declaration init_list params param_list stmts args arg_list
+%type <node> function init param block stmt simple opt_simple opt_expr
+%type <node> expression call
+
+%left OR
+%left AND
+%left EQ NE
+%left '<' '>' LE GE
+%left '+' '-'
+%left '*' '/' '%'
+%right '!' UMINUS
+
+%nonassoc LOWER_THAN_ELSE
+%nonassoc ELSE
 
 %%
 
 program:
-    declarations main_function
-    | error { yyerror("Syntax error in program"); }
+    items { program = $1.head; }
     ;
 
-declarations:
-    declaration declarations
-    | /* empty */
+items:
+    /* empty */ { $$ = list_one(NULL); decls = 0; }
+    | items declaration { $$ = list_cat($1, $2); decls = 0; }
+    | items function { $$ = list_add($1, $2); decls = 0; }
+    | items error ';' { RECOVER; decls = 0; }
+    | items error '}' { RECOVER; decls = 0; }
+    | items error block { RECOVER; decls = 0; }
     ;
 
 declaration:
-    ID ID ';'
-    | ID ID '=' expression ';'
+    TYPE init_list ';' { $$ = typed($2, $1, 0); }
+    | CONST TYPE init_list ';' { $$ = typed($3, $2, F_CONST); }
+    | TYPE error ';' { RECOVER; $$ = list_one(NULL); }
+    | CONST error ';' { RECOVER; $$ = list_one(NULL); }
+    ;
+
+init_list:
+    init { $$ = list_one($1); }
+    | init_list ',' init { $$ = list_add($1, $3); }
+    ;
+
+init:
+    ID { $$ = node_sym(N_VAR, $1, tokline); decls++; }
+    | ID '=' expression {
+        $$ = node_sym(N_VAR, $1, tokline);
+        if ($$) $$->a = $3;
+        decls++;
+    }
+    ;
+
+function:
+    TYPE ID '(' params ')' block {
+        $$ = node_sym(N_FUNC, $2, tokline);
+        if ($$) { $$->op = $1; $$->a = $4.head; $$->b = $6; $$->v.i = decls; }
+    }
+    | ID '(' params ')' block {
+        $$ = node_sym(N_FUNC, $1, tokline);
+        if ($$) { $$->op = TY_VOID; $$->a = $3.head; $$->b = $5; $$->v.i = decls; }
+    }
+    ;
+
+params:
+    /* empty */ { $$ = list_one(NULL); }
+    | param_list
     ;
 
-main_function:
-    VOID MAIN '(' ')' block
+param_list:
+    param { $$ = list_one($1); }
+    | param_list ',' param { $$ = list_add($1, $3); }
+    ;
+
+param:
+    TYPE ID {
+        $$ = node_sym(N_PARAM, $2, tokline);
+        if ($$) $$->op = $1;
+        decls++;
+    }
+    | ID {
+        $$ = node_sym(N_PARAM, $1, tokline);
+        if ($$) $$->op = TY_INT;
+        decls++;
+    }
     ;
 
 block:
-    '{' statements '}'
+    '{' stmts '}' { $$ = node_op(N_BLOCK, 0, $2.head, NULL, tokline); }
+    | '{' stmts error '}' {
+        RECOVER;
+        $$ = node_op(N_BLOCK, 0, $2.head, NULL, tokline);
+    }
+    ;
+
+stmts:
+    /* empty */ { $$ = list_one(NULL); }
+    | stmts declaration { $$ = list_cat($1, $2); }
+    | stmts stmt { $$ = list_add($1, $2); }
+    ;
+
+stmt:
+    simple ';'
+    | PRINT expression ';' { $$ = node_op(N_PRINT, PRINT, $2, NULL, tokline); }
+    | PRINTLN expression ';' { $$ = node_op(N_PRINT, PRINTLN, $2, NULL, tokline); }
+    | READ ID ';' { $$ = node_sym(N_READ, $2, tokline); }
+    | RETURN opt_expr ';' { $$ = node_op(N_RETURN, 0, $2, NULL, tokline); }
+    | BREAK ';' { $$ = node(N_BREAK, tokline); }
+    | CONTINUE ';' { $$ = node(N_CONTINUE, tokline); }
+    | IF '(' expression ')' stmt %prec LOWER_THAN_ELSE {
+        $$ = node_op(N_IF, 0, $3, $5, tokline);
+    }
+    | IF '(' expression ')' stmt ELSE stmt {
+        $$ = node_op(N_IF, 0, $3, $5, tokline);
+        if ($$) $$->c = $7;
+    }
+    | WHILE '(' expression ')' stmt { $$ = node_op(N_WHILE, 0, $3, $5, tokline); }
+    | FOR '(' opt_simple ';' opt_expr ';' opt_simple ')' stmt {
+        $$ = node_op(N_FOR, 0, $3, $5, tokline);
+        if ($$) { $$->c = $7; $$->d = $9; }
+    }
+    | FOREACH '(' ID ':' expression '.' '.' expression ')' stmt {
+        $$ = node_op(N_FOREACH, 0, $5, $8, tokline);
+        if ($$) { $$->sym = $3; $$->c = $10; }
+    }
+    | block
+    | error ';' { RECOVER; $$ = NULL; }
+    | error block { RECOVER; $$ = $2; }
     ;
 
-statements:
-    statement statements
-    | /* empty */
+simple:
+    ID '=' expression {
+        $$ = node_op(N_ASSIGN, 0, $3, NULL, tokline);
+        if ($$) $$->sym = $1;
+    }
+    | ID INC {
+        $$ = node_op(N_INCR, INC, NULL, NULL, tokline);
+        if ($$) $$->sym = $1;
+    }
+    | ID DEC {
+        $$ = node_op(N_INCR, DEC, NULL, NULL, tokline);
+        if ($$) $$->sym = $1;
+    }
+    | call { $$ = node_op(N_EXPR, 0, $1, NULL, tokline); }
     ;
 
-statement:
-    assignment
-    | print_statement
-    | conditional
+opt_simple:
+    /* empty */ { $$ = NULL; }
+    | simple
     ;
 
-assignment:
-    ID '=' expression ';'
+opt_expr:
+    /* empty */ { $$ = NULL; }
+    | expression
     ;
 
-print_statement:
-    PRINT expression ';'
+call:
+    ID '(' args ')' {
+        $$ = node_op(N_CALL, 0, $3.head, NULL, tokline);
+        if ($$) $$->sym = $1;
+    }
     ;
 
-conditional:
-    IF '(' expression ')' block
-    | IF '(' expression ')' block ELSE block
+args:
+    /* empty */ { $$ = list_one(NULL); }
+    | arg_list
+    ;
+
+arg_list:
+    expression { $$ = list_one($1); }
+    | arg_list ',' expression { $$ = list_add($1, $3); }
     ;
 
 expression:
-    INT
-    | REAL
-    | STRING
-    | ID
-    | '(' expression ')'
-    | expression OP expression
+    INT {
+        $$ = node(N_INT, tokline);
+        if ($$) $$->v.i = $1;
+    }
+    | REAL {
+        $$ = node(N_REAL, tokline);
+        if ($$) $$->v.r = $1;
+    }
+    | STRING {
+        $$ = node(N_STRING, tokline);
+        if ($$) $$->v.s = $1;
+    }
+    | TRUE {
+        $$ = node(N_BOOL, tokline);
+        if ($$) $$->v.i = 1;
+    }
+    | FALSE { $$ = node(N_BOOL, tokline); }
+    | ID { $$ = node_sym(N_NAME, $1, tokline); }
+    | call
+    | '(' expression ')' { $$ = $2; }
+    | expression OR expression { $$ = node_op(N_BINARY, OR, $1, $3, tokline); }
+    | expression AND expression { $$ = node_op(N_BINARY, AND, $1, $3, tokline); }
+    | expression EQ expression { $$ = node_op(N_BINARY, EQ, $1, $3, tokline); }
+    | expression NE expression { $$ = node_op(N_BINARY, NE, $1, $3, tokline); }
+    | expression '<' expression { $$ = node_op(N_BINARY, '<', $1, $3, tokline); }
+    | expression '>' expression { $$ = node_op(N_BINARY, '>', $1, $3, tokline); }
+    | expression LE expression { $$ = node_op(N_BINARY, LE, $1, $3, tokline); }
+    | expression GE expression { $$ = node_op(N_BINARY, GE, $1, $3, tokline); }
+    | expression '+' expression { $$ = node_op(N_BINARY, '+', $1, $3, tokline); }
+    | expression '-' expression { $$ = node_op(N_BINARY, '-', $1, $3, tokline); }
+    | expression '*' expression { $$ = node_op(N_BINARY, '*', $1, $3, tokline); }
+    | expression '/' expression { $$ = node_op(N_BINARY, '/', $1, $3, tokline); }
+    | expression '%' expression { $$ = node_op(N_BINARY, '%', $1, $3, tokline); }
+    | '-' expression %prec UMINUS { $$ = node_op(N_UNARY, '-', $2, NULL, tokline); }
+    | '!' expression { $$ = node_op(N_UNARY, '!', $2, NULL, tokline); }
     ;
 
 %%
 
+// Parser-side token hook: replays a token array or pulls from the scanner
+// --time-report scans ahead of the parser in batches, so the two can be
+// timed apart with a clock read per batch instead of two per token; a token
+// stream file is replayed the same way. --pipeline takes its batches from a
+// scanner thread instead.
+#define BATCH 4096
+static Token *batch;    // batch[0] keeps the last token of the batch before
+static int (*batch_next)(Token *t);     // scan_next or stream_next
+static _Thread_local int (*refill)(void);  // next batch into replay; NULL for an array
+
+static int refill_batch(void) {
+    batch[0] = replay[-1];
+    int n = 0;
+    PHASE_PUSH(PH_SCAN);
+    while (n < BATCH && batch_next(&batch[1 + n])) n++;
+    PHASE_POP();
+    // Short of a full batch, batch_next has put the end token after the last
+    if (n < BATCH) n++;
+    replay = batch + 1;
+    replay_end = replay + n;
+    return n;
+}
+
+// The last batch holds just the end token
+static int refill_pipe(void) {
+    int n;
+    replay = pipe_take(&n);
+    replay_end = replay + (n ? n : 1);
+    return 1;
+}
+
+// Symbol id for the trace; --check never interns names
+static int token_sym(int kind, const YYSTYPE *val) {
+    return kind == ID && !check_only ? val->sym : -1;
+}
+
+int yylex(YYSTYPE *lval) {
+    if (replay) {
+        while (replay == replay_end || replay->kind == TRIVIA) {
+            if (replay != replay_end) replay++;
+            else if (refill == NULL || !refill()) return 0;
+        }
+        *lval = replay->val;
+        // The scanner thread must not touch the tree arena, so string values
+        // are made here
+        if (defer_strings && replay->kind == STRING && !check_only)
+            lval->sval = string_value(replay_text + replay->off, replay->len);
+        tokline = replay->line;
+        if (trace && replay->kind != 0)
+            trace_token(replay->kind, replay->off, replay->len, token_sym(replay->kind, lval));
+        return (replay++)->kind;
+    }
+    int token = scan();
+    *lval = yylval;
+    tokline = linenum;
+    if (trace && token != 0)
+        trace_token(token, scan_offset - yyleng, yyleng, token_sym(token, lval));
+    return token;
+}
+
+// Parse the tokens next produces, fetched in batches ahead of the parser
+static int parse_batched(const char *text, int (*next)(Token *t)) {
+    static Token tokens[BATCH + 1];
+    batch = tokens;
+    batch_next = next;
+    refill = refill_batch;
+    replay_text = text;
+    replay_base = 0;
+    replay = replay_end = batch + 1;
+    int status = yyparse();
+    replay = NULL;
+    refill = NULL;
+    batch = NULL;
+    return status;
+}
+
+// Parse text while a second thread scans it; batched on this one if the
+// thread can't be started
+static int parse_piped(char *text, size_t len) {
+    static const Token none[1];
+    defer_strings = 1;
+    if (!pipe_start(text, len)) {
+        perror("pipeline");
+        defer_strings = 0;
+        scan_begin(text, len, SCAN_INITIAL, 1);
+        return parse_batched(text, scan_next);
+    }
+    refill = refill_pipe;
+    replay_text = text;
+    replay_base = 0;
+    replay = replay_end = none + 1;
+    int status = yyparse();
+    pipe_finish();
+    replay = NULL;
+    refill = NULL;
+    defer_strings = 0;
+    return status;
+}
+
+// Parse a pre-scanned token array; returns its top-level nodes
+Node *parse_tokens(const char *text, const Token *t, int n, int line_base, int *errs) {
+    int count = 0;
+    counted = &count;   // the error cap applies per token array
+    replay_text = text;
+    replay = t;
+    replay_end = t + n + 1;
+    replay_base = line_base;
+    program = NULL;
+    yyparse();
+    replay = NULL;
+    counted = &errors;
+    *errs = count;
+    __atomic_add_fetch(&errors, count, __ATOMIC_RELAXED);
+    return program;
+}
+
+#ifdef PROFILE
+static long reduce_hits[YYNRULES + 1];  // indexed by bison's rule number
+
+// Parsers run on several threads at once (--pipeline, --jobs)
+static void profile_reduce(int rule) {
+    __atomic_add_fetch(&reduce_hits[rule], 1, __ATOMIC_RELAXED);
+}
+
+static int by_hits(const void *a, const void *b) {
+    long x = reduce_hits[*(const int *)a], y = reduce_hits[*(const int *)b];
+    return (x < y) - (x > y);
+}
+
+// Rules by name of the nonterminal they reduce to and their line here
+void parse_profile(FILE *f) {
+    int order[YYNRULES];
+    long total = 0;
+    for (int r = 1; r <= YYNRULES; r++) {
+        order[r - 1] = r;
+        total += reduce_hits[r];
+    }
+    qsort(order, YYNRULES, sizeof(int), by_hits);
+    fprintf(f, "%-24s %12s %7s\n", "reduction", "hits", "share");
+    for (int i = 0; i < YYNRULES; i++) {
+        int r = order[i];
+        char name[64];
+        snprintf(name, sizeof(name), "%s:%d", yytname[yyr1[r]], yyrline[r]);
+        fprintf(f, "%-24s %12ld %6.2f%%\n", name, reduce_hits[r],
+                total ? 100.0 * reduce_hits[r] / total : 0);
+    }
+    fprintf(f, "%-24s %12ld\n", "total", total);
+}
+
+static void dump_profile(void) {
+    scan_profile(stderr);
+    fprintf(stderr, "\n");
+    parse_profile(stderr);
+}
+#endif
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static char *read_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *text = mem_alloc(*len + 2);
+    *len = fread(text, 1, *len, f);
+    text[*len] = text[*len + 1] = '\0';
+    fclose(f);
+    return text;
+}
+
+// Print the --time-report and --mem-report tables, if asked for, on the way
+// out, and flush the token trace
+static int finish(int status) {
+    if (trace && !trace_close()) {
+        perror("trace");
+        status = 1;
+    }
+    if (time_report) phase_report(stderr, time_report == 2);
+    if (mem_report) mem_stats(stderr, mem_report == 2);
+    return status;
+}
+
+// Error count on stderr; returns the exit status for a parse that returned
+// status
+static int summary(int status) {
+    if (errors > 0)
+        fprintf(stderr, "%d error%s\n", errors, errors == 1 ? "" : "s");
+    return status != 0 || errors != 0;
+}
+
+// Semantic passes, once there is a tree without syntax errors
+static void analyze(void) {
+    if (check_only || errors > 0 || program == NULL) return;
+    PHASE_PUSH(PH_SEMA);
+    analyze_program(program, sema_jobs);
+    if (unused) warn_unused();
+    PHASE_POP();
+}
+
+// --run: compile the program and execute it, once it has no errors;
+// returns the exit status
+static int execute(int status) {
+    if (!run || status != 0 || program == NULL) return status;
+    PHASE_PUSH(PH_COMPILE);
+    Program *p = compile(program);
+    PHASE_POP();
+    if (p == NULL) return summary(0);
+    PHASE_PUSH(PH_RUN);
+    status = vm_run(p);
+    PHASE_POP();
+    program_free(p);
+    return status;
+}
+
+// --edit OFF,DEL,TEXT: parse once, then apply each edit incrementally
+static int run_edits(const char *path, char **edits, int nedits) {
+    size_t len;
+    PHASE_PUSH(PH_OPEN);
+    char *text = read_file(path, &len);
+    PHASE_POP();
+    if (!text) {
+        perror("fopen");
+        return 1;
+    }
+    Doc doc;
+    double t0 = now_us();
+    doc_open(&doc, text, len);
+    printf("initial parse: %.1f us, %d items\n", now_us() - t0, doc.n);
+    mem_free(text);
+    for (int i = 0; i < nedits; i++) {
+        int off, del, pos;
+        if (sscanf(edits[i], "%d,%d,%n", &off, &del, &pos) != 2 ||
+            off < 0 || del < 0 || off + del > doc.len) {
+            fprintf(stderr, "Bad edit '%s'\n", edits[i]);
+            return 1;
+        }
+        const char *ins = edits[i] + pos;
+        t0 = now_us();
+        int reparsed = doc_edit(&doc, off, del, ins, strlen(ins));
+        printf("edit %d: %.1f us, %d of %d items reparsed\n",
+               i + 1, now_us() - t0, reparsed, doc.n);
+    }
+    int errs = doc_errors(&doc);
+    doc_close(&doc);
+    return errs != 0;
+}
+
 int main(int argc, char **argv) {
-    if (argc != 2) {
-        printf("Usage: %s <input file>\n", argv[0]);
+    const char *path = NULL, *trace_path = NULL, *emit_path = NULL, *cache_dir = NULL;
+    long cache_limit = 64L << 20;
+    char *edits[argc];
+    int nedits = 0;
+#ifdef PROFILE
+    atexit(dump_profile);
+#endif
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--check") == 0) check_only = 1;
+        else if (strcmp(argv[i], "--quiet") == 0) quiet = 1;
+        else if (strcmp(argv[i], "--scan-only") == 0) scan_only = 1;
+        else if (strcmp(argv[i], "--time-report") == 0) time_report = 1;
+        else if (strcmp(argv[i], "--time-report=json") == 0) time_report = 2;
+        else if (strcmp(argv[i], "--mem-report") == 0) mem_report = 1;
+        else if (strcmp(argv[i], "--mem-report=json") == 0) mem_report = 2;
+        else if (strcmp(argv[i], "--max-errors") == 0 && i + 1 < argc)
+            max_errors = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--stack-budget") == 0 && i + 1 < argc)
+            stack_budget = atol(argv[++i]);
+        else if (strcmp(argv[i], "--from-tokens") == 0) from_tokens = 1;
+        else if (strcmp(argv[i], "--pipeline") == 0) pipeline = 1;
+        else if (strcmp(argv[i], "--warn-unused") == 0) unused = 1;
+        else if (strcmp(argv[i], "--run") == 0) run = quiet = 1;
+        else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+            sema_jobs = jobs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--emit-tokens") == 0 && i + 1 < argc)
+            emit_path = argv[++i];
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+            cache_dir = argv[++i];
+        else if (strcmp(argv[i], "--cache-size") == 0 && i + 1 < argc)
+            cache_limit = atol(argv[++i]);
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            trace_path = argv[++i];
+        else if (strcmp(argv[i], "--edit") == 0 && i + 1 < argc)
+            edits[nedits++] = argv[++i];
+        else if (path == NULL) path = argv[i];
+        else {
+            path = NULL;
+            break;
+        }
+    }
+    if (path == NULL) {
+        printf("Usage: %s [--check | --quiet | --scan-only] [--max-errors N]\n"
+               "       [--stack-budget BYTES] [--time-report[=json]]\n"
+               "       [--mem-report[=json]] [--trace FILE] [--edit OFF,DEL,TEXT]...\n"
+               "       [--emit-tokens FILE | --from-tokens | --pipeline | --jobs N]\n"
+               "       [--cache DIR] [--cache-size BYTES] [--warn-unused] [--run]\n"
+               "       <input file>\n", argv[0]);
         return 1;
     }
 
-    yyin = fopen(argv[1], "r");
-    if (!yyin) {
-        perror("fopen");
+    listing = !check_only && !quiet && !scan_only && nedits == 0 && !emit_path && !from_tokens;
+    if (nedits > 0) return finish(run_edits(path, edits, nedits));
+    if (trace_path) {
+        if (!trace_open(trace_path)) {
+            perror(trace_path);
+            return 1;
+        }
+        trace = 1;
+    }
+
+    // --emit-tokens: scan only, saving the tokens for a later --from-tokens
+    if (emit_path) {
+        size_t len;
+        PHASE_PUSH(PH_OPEN);
+        char *text = read_file(path, &len);
+        PHASE_POP();
+        if (!text) {
+            perror("fopen");
+            return 1;
+        }
+        PHASE_PUSH(PH_SCAN);
+        long tokens = stream_write(emit_path, text, len);
+        PHASE_POP();
+        mem_free(text);
+        if (tokens < 0) {
+            perror(emit_path);
+            return 1;
+        }
+        printf("%ld tokens\n", tokens);
+        return finish(errors != 0);
+    }
+
+    if (scan_only) {
+        PHASE_PUSH(PH_OPEN);
+        yyin = fopen(path, "r");
+        PHASE_POP();
+        if (!yyin) {
+            perror("fopen");
+            return 1;
+        }
+        long tokens = 0;
+        PHASE_PUSH(PH_SCAN);
+        for (int t; (t = scan()) != 0; tokens++)
+            if (trace) trace_token(t, scan_offset - yyleng, yyleng, token_sym(t, &yylval));
+        PHASE_POP();
+        fclose(yyin);
+        printf("%ld tokens\n", tokens);
+        return finish(errors != 0);
+    }
+
+    // The parse cache only stands in for runs that print nothing but
+    // diagnostics, and a traced run has to see the tokens
+    if (listing || from_tokens || trace) cache_dir = NULL;
+    // Parts are scanned and parsed apart, so nothing may be echoed or traced
+    // in token order
+    if (listing || from_tokens || trace) jobs = 0;
+
+    // Reported, cached, pipelined and split runs read the whole input up front and
+    // scan it in batches, so scanning and parsing are charged apart;
+    // otherwise the scanner streams from the file as the parser asks
+    char *text = NULL;
+    size_t len;
+    int opened;
+    PHASE_PUSH(PH_OPEN);
+    if (from_tokens) opened = stream_open(path);
+    else if (time_report || mem_report || cache_dir || pipeline || jobs > 0)
+        opened = (text = read_file(path, &len)) != NULL;
+    else opened = (yyin = fopen(path, "r")) != NULL;
+    // flex reads whole buffers, so --check keeps no stdio buffer under its own
+    if (check_only && yyin) setvbuf(yyin, NULL, _IONBF, 0);
+    PHASE_POP();
+    if (!opened) {
+        if (!from_tokens) perror("fopen");
         return 1;
     }
 
-    printf("Starting parsing...\n");
+    if (!check_only && !quiet) printf("Starting parsing...\n");
 
-    int token;
-    while ((token = yylex()) != 0) {
-        printf("Token: %d, Text: %s\n", token, yytext);
+    // Everything that changes the result is part of the key
+    uint64_t key = 0;
+    int status;
+    if (cache_dir) {
+        long opts[] = { check_only, max_errors, stack_budget };
+        PHASE_PUSH(PH_CACHE);
+        key = cache_key(text, len, opts, sizeof(opts));
+        int hit = cache_load(cache_dir, key, &status);
+        PHASE_POP();
+        if (hit) {
+            mem_free(text);
+            analyze();
+            return finish(execute(summary(status)));
+        }
+        cache_record();
     }
 
-    fclose(yyin);
-    return 0;
-}
\ No newline at end of file
+    PHASE_PUSH(PH_PARSE);
+    if (from_tokens) {
+        status = parse_batched(NULL, stream_next);
+    } else if (jobs > 0) {
+        parse_parallel(text, len, jobs);
+        status = 0;
+    } else if (pipeline) {
+        status = parse_piped(text, len);
+    } else if (text) {
+        scan_begin(text, len, SCAN_INITIAL, 1);
+        status = parse_batched(text, scan_next);
+    } else {
+        status = yyparse();
+    }
+    PHASE_POP();
+
+    if (cache_dir) {
+        PHASE_PUSH(PH_CACHE);
+        cache_store(cache_dir, key, status, cache_limit);
+        PHASE_POP();
+    }
+    if (from_tokens) stream_close();
+    else if (text) mem_free(text);
+    else fclose(yyin);
+    analyze();
+    return finish(execute(summary(status)));
+}
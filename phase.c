@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "phase.h"
+
+#define MAX_NESTING 16
+
+int time_report = 0;
+
+static const char *names[NPHASES] = {
+    "open", "scan", "parse", "edit", "cache", "sema", "compile", "run"
+};
+static double self_ns[NPHASES];
+static long calls[NPHASES];
+// Only the main thread opens phases; any other thread sees none open
+static _Thread_local int stack[MAX_NESTING];
+static _Thread_local int depth = 0;
+static double start = 0, last = 0;
+static long reads = 0;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Charge the time since the last switch to the phase on top of the stack
+static void charge(void) {
+    double t = now_ns();
+    if (start == 0) start = t;
+    else if (depth > 0 && depth <= MAX_NESTING) self_ns[stack[depth - 1]] += t - last;
+    last = t;
+    reads++;
+}
+
+void phase_push(int p) {
+    charge();
+    if (depth < MAX_NESTING) stack[depth] = p;
+    depth++;
+    calls[p]++;
+}
+
+void phase_pop(void) {
+    charge();
+    depth--;
+}
+
+int phase_current(void) {
+    if (depth <= 0) return -1;
+    return stack[(depth < MAX_NESTING ? depth : MAX_NESTING) - 1];
+}
+
+const char *phase_name(int p) {
+    return names[p];
+}
+
+// Cost of one clock read, so the report can say how much of it is the timer
+static double clock_cost(void) {
+    double t0 = now_ns(), t = t0;
+    for (int i = 0; i < 1000; i++) t = now_ns();
+    return (t - t0) / 1000;
+}
+
+void phase_report(FILE *f, int json) {
+#ifdef NO_TIME_REPORT
+    fprintf(f, "time report compiled out (NO_TIME_REPORT)\n");
+    return;
+#endif
+    double total = start ? now_ns() - start : 0, in_phases = 0;
+    double overhead = reads * clock_cost();
+    for (int p = 0; p < NPHASES; p++) in_phases += self_ns[p];
+    if (json) {
+        fprintf(f, "{\"phases\": [");
+        for (int p = 0; p < NPHASES; p++)
+            fprintf(f, "%s{\"name\": \"%s\", \"ms\": %.3f, \"calls\": %ld}", p ? ", " : "",
+                    names[p], self_ns[p] / 1e6, calls[p]);
+        fprintf(f, "], \"other_ms\": %.3f, \"total_ms\": %.3f, \"timer_overhead_ms\": %.3f}\n",
+                (total - in_phases) / 1e6, total / 1e6, overhead / 1e6);
+        return;
+    }
+    fprintf(f, "%-8s %12s %7s %10s\n", "phase", "ms", "share", "calls");
+    for (int p = 0; p < NPHASES; p++) {
+        if (calls[p] == 0) continue;
+        fprintf(f, "%-8s %12.3f %6.1f%% %10ld\n", names[p], self_ns[p] / 1e6,
+                total ? 100 * self_ns[p] / total : 0, calls[p]);
+    }
+    fprintf(f, "%-8s %12.3f %6.1f%%\n", "other", (total - in_phases) / 1e6,
+            total ? 100 * (total - in_phases) / total : 0);
+    fprintf(f, "%-8s %12.3f\n", "total", total / 1e6);
+    fprintf(f, "(timer overhead about %.3f ms over %ld clock reads)\n", overhead / 1e6, reads);
+}
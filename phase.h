@@ -0,0 +1,42 @@
+#ifndef PHASE_H
+#define PHASE_H
+
+#include <stdio.h>
+
+#include "mem.h"
+
+// Pipeline phases for --time-report and --mem-report
+enum {
+    PH_OPEN,        // opening and reading the input
+    PH_SCAN,        // inside the scanner
+    PH_PARSE,       // inside yyparse, scanning excluded
+    PH_EDIT,        // incremental edit bookkeeping, scan and parse excluded
+    PH_CACHE,       // hashing the input, parse cache lookup and store
+    PH_SEMA,        // semantic passes over the tree
+    PH_COMPILE,     // tree to bytecode, for --run
+    PH_RUN,         // executing the bytecode
+    NPHASES
+};
+
+// Phases nest; each one is charged only the time no inner phase was open.
+// A push or pop reads the clock, so phases must not be entered per token.
+// Build with -DNO_TIME_REPORT to compile every hook out; --mem-report then
+// charges every allocation to "other", as it does allocations made by the
+// --pipeline scanner thread.
+#ifndef NO_TIME_REPORT
+#define PHASE_PUSH(p) (time_report || mem_report ? phase_push(p) : (void)0)
+#define PHASE_POP() (time_report || mem_report ? phase_pop() : (void)0)
+#else
+#define PHASE_PUSH(p) ((void)0)
+#define PHASE_POP() ((void)0)
+#endif
+
+extern int time_report;     // 0 off, 1 table, 2 JSON
+
+void phase_push(int p);
+void phase_pop(void);
+int phase_current(void);     // innermost open phase, -1 if none
+const char *phase_name(int p);
+void phase_report(FILE *f, int json);
+
+#endif
@@ -0,0 +1,111 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include "pipeline.h"
+#include "mem.h"
+
+// One batch; t[0] is filled in by the parser side with the last token of the
+// batch before, so t[1..n] can be replayed as if the tokens were contiguous
+typedef struct {
+    int n;
+    Token t[PIPE_BATCH + 1];
+} Slot;
+
+// Slots are used round robin. filled counts the batches the scanner has
+// published, freed those the parser is done with; the scanner owns a slot
+// between the two, the parser owns the rest. Each count has one writer.
+static Slot *ring;
+static atomic_long filled, freed;
+static atomic_int stop;
+static pthread_t thread;
+static char *src;
+static size_t src_len;
+
+// Parser side only
+static long taken;
+static Slot *cur;
+static int ended;
+
+// Wait until slot i is free; NULL if the parser asked us to stop meanwhile
+static Slot *claim(long i) {
+    while (i - atomic_load_explicit(&freed, memory_order_acquire) == PIPE_RING) {
+        if (atomic_load_explicit(&stop, memory_order_relaxed)) return NULL;
+        sched_yield();
+    }
+    if (atomic_load_explicit(&stop, memory_order_relaxed)) return NULL;
+    return &ring[i % PIPE_RING];
+}
+
+// A batch comes out empty only once the input is used up, and that empty
+// batch is the last one published
+static void *scanner(void *arg) {
+    (void)arg;
+    long i = 0;
+    int more = 1;
+    Token end;
+    Slot *s;
+    scan_begin(src, src_len, SCAN_INITIAL, 1);
+    while ((s = claim(i)) != NULL) {
+        int n = 0, was = more;
+        while (more && n < PIPE_BATCH && (more = scan_next(&s->t[1 + n])))
+            if (s->t[1 + n].kind != TRIVIA) n++;
+        // scan_next leaves the end token after the last one; the last batch,
+        // the empty one, carries it
+        if (!more && n > 0) end = s->t[1 + n];
+        else if (!was) s->t[1] = end;
+        s->n = n;
+        atomic_store_explicit(&filled, ++i, memory_order_release);
+        if (n == 0) break;
+    }
+    scan_stop();
+    return NULL;
+}
+
+int pipe_start(char *text, size_t len) {
+    ring = mem_alloc(PIPE_RING * sizeof(Slot));
+    atomic_store(&filled, 0);
+    atomic_store(&freed, 0);
+    atomic_store(&stop, 0);
+    taken = 0;
+    cur = NULL;
+    ended = 0;
+    src = text;
+    src_len = len;
+    if (pthread_create(&thread, NULL, scanner, NULL) != 0) {
+        mem_free(ring);
+        ring = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+const Token *pipe_take(int *n) {
+    if (ended) {
+        *n = 0;
+        return cur->t + 1;
+    }
+    while (atomic_load_explicit(&filled, memory_order_acquire) == taken)
+        sched_yield();
+    Slot *s = &ring[taken % PIPE_RING];
+    if (cur) {
+        s->t[0] = cur->t[cur->n];
+        atomic_store_explicit(&freed, taken, memory_order_release);
+    } else {
+        memset(&s->t[0], 0, sizeof(Token));
+    }
+    taken++;
+    cur = s;
+    ended = s->n == 0;
+    *n = s->n;
+    return s->t + 1;
+}
+
+void pipe_finish(void) {
+    if (ring == NULL) return;
+    atomic_store_explicit(&stop, 1, memory_order_relaxed);
+    pthread_join(thread, NULL);
+    mem_free(ring);
+    ring = NULL;
+}
@@ -0,0 +1,28 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stddef.h>
+
+#include "token.h"
+
+// Scanning on a thread of its own, ahead of the parser: the scanner fills
+// batches of tokens in a small ring, the parser takes them in order. When
+// every slot is full the scanner waits for the parser to free one, so it is
+// never more than PIPE_RING batches ahead.
+#define PIPE_BATCH 4096
+#define PIPE_RING 8
+
+// Start scanning text[0..len), which must be followed by two NUL bytes.
+// Nothing else may use the scanner until pipe_finish.
+int pipe_start(char *text, size_t len);
+
+// The next batch of tokens, comments left out; sets *n to 0 at the end,
+// with t[0] the end token (token.h). The batch stays valid until the next
+// call, and t[-1] is the last token of the batch before (a blank token
+// before the first).
+const Token *pipe_take(int *n);
+
+// Stop the scanner if it is still running and wait for it
+void pipe_finish(void);
+
+#endif
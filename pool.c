@@ -0,0 +1,82 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "pool.h"
+
+// A share of task indices, [lo, hi), packed into one word so the owner
+// taking from the front and thieves cutting the back agree through one
+// compare-and-swap
+#define PACK(lo, hi) ((uint64_t)(uint32_t)(lo) << 32 | (uint32_t)(hi))
+#define LO(r) ((int)((r) >> 32))
+#define HI(r) ((int)(uint32_t)(r))
+
+typedef struct {
+    _Alignas(64) _Atomic uint64_t share;    // one cache line per worker
+} Share;
+
+static Share shares[MAX_WORKERS];
+static int workers;
+static void (*run)(int i, int worker, void *arg);
+static void *run_arg;
+
+// Next task of worker w's own share, -1 if it is empty
+static int take(int w) {
+    uint64_t r = atomic_load(&shares[w].share);
+    while (LO(r) < HI(r))
+        if (atomic_compare_exchange_weak(&shares[w].share, &r, PACK(LO(r) + 1, HI(r))))
+            return LO(r);
+    return -1;
+}
+
+// Move the back half of the largest other share to w; 0 if all are empty
+static int steal(int w) {
+    for (;;) {
+        int victim = -1, most = 0;
+        uint64_t r = 0;
+        for (int v = 0; v < workers; v++) {
+            uint64_t s = atomic_load(&shares[v].share);
+            if (v != w && HI(s) - LO(s) > most) {
+                victim = v;
+                most = HI(s) - LO(s);
+                r = s;
+            }
+        }
+        if (victim < 0) return 0;
+        int cut = HI(r) - (most + 1) / 2;
+        if (atomic_compare_exchange_strong(&shares[victim].share, &r, PACK(LO(r), cut))) {
+            atomic_store(&shares[w].share, PACK(cut, HI(r)));
+            return 1;
+        }
+    }
+}
+
+static void work(int w) {
+    do {
+        for (int i; (i = take(w)) >= 0;) run(i, w, run_arg);
+    } while (steal(w));
+}
+
+static void *worker(void *arg) {
+    work((int)(intptr_t)arg);
+    return NULL;
+}
+
+void pool_run(int n, int jobs, void (*task)(int i, int worker, void *arg), void *arg) {
+    if (jobs < 1) jobs = 1;
+    if (jobs > MAX_WORKERS) jobs = MAX_WORKERS;
+    if (jobs > n) jobs = n > 0 ? n : 1;
+    workers = jobs;
+    run = task;
+    run_arg = arg;
+    for (int w = 0; w < jobs; w++)
+        atomic_store(&shares[w].share, PACK((long)n * w / jobs, (long)n * (w + 1) / jobs));
+    pthread_t threads[MAX_WORKERS];
+    int started = 1;
+    while (started < jobs &&
+           pthread_create(&threads[started], NULL, worker, (void *)(intptr_t)started) == 0)
+        started++;
+    // A worker that failed to start leaves its share to be stolen
+    work(0);
+    for (int t = 1; t < started; t++) pthread_join(threads[t], NULL);
+}
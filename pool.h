@@ -0,0 +1,13 @@
+#ifndef POOL_H
+#define POOL_H
+
+// Work-stealing pool for a fixed set of independent tasks. Each worker
+// starts with an even share of the task indices and takes them from the
+// front of its share; one that runs out steals the back half of the largest
+// share left. Run task(i, worker, arg) for every i in [0, n) on jobs
+// threads, this one included as worker 0, and return once all are done.
+#define MAX_WORKERS 64
+
+void pool_run(int n, int jobs, void (*task)(int i, int worker, void *arg), void *arg);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+
+// Instrumented builds (-DPROFILE, make parser-profile) count every scanner
+// rule and every grammar reduction that fires; main prints both at exit.
+void scan_profile(FILE *f);     // scanner.l
+void parse_profile(FILE *f);    // parser.y
+
+#endif
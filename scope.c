@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "scope.h"
+#include "sema.h"
+#include "cache.h"
+#include "mem.h"
+
+// The scanner's names
+extern char **symbolTable;
+
+Symbols syms;
+
+// Binding a declaration replaced, restored when its scope ends
+struct Undo {
+    int name;
+    int prev;
+};
+
+// Undo log length and free slot where a scope began
+struct Mark {
+    int undo;
+    int slot;
+};
+
+static void *reserve(void *p, int *cap, int need, size_t size) {
+    if (need <= *cap) return p;
+    while (*cap < need) *cap = *cap ? *cap * 2 : 256;
+    return mem_realloc(p, *cap * size);
+}
+
+void syms_reserve(int n) {
+    if (n <= syms.cap) return;
+    while (syms.cap < n) syms.cap = syms.cap ? syms.cap * 2 : 256;
+    syms.name = mem_realloc(syms.name, syms.cap * sizeof(*syms.name));
+    syms.kind = mem_realloc(syms.kind, syms.cap * sizeof(*syms.kind));
+    syms.type = mem_realloc(syms.type, syms.cap * sizeof(*syms.type));
+    syms.flags = mem_realloc(syms.flags, syms.cap * sizeof(*syms.flags));
+    syms.depth = mem_realloc(syms.depth, syms.cap * sizeof(*syms.depth));
+    syms.line = mem_realloc(syms.line, syms.cap * sizeof(*syms.line));
+    syms.item = mem_realloc(syms.item, syms.cap * sizeof(*syms.item));
+    syms.uses = mem_realloc(syms.uses, syms.cap * sizeof(*syms.uses));
+    syms.value = mem_realloc(syms.value, syms.cap * sizeof(*syms.value));
+    syms.slot = mem_realloc(syms.slot, syms.cap * sizeof(*syms.slot));
+}
+
+void scope_init(Scope *s, const int *binding, int nnames) {
+    memset(s, 0, sizeof(*s));
+    s->binding = mem_alloc((nnames ? nnames : 1) * sizeof(int));
+    if (binding) memcpy(s->binding, binding, nnames * sizeof(int));
+    else memset(s->binding, 0xff, nnames * sizeof(int));
+}
+
+void scope_free(Scope *s) {
+    mem_free(s->binding);
+    mem_free(s->undo);
+    mem_free(s->marks);
+    memset(s, 0, sizeof(*s));
+}
+
+void scope_push(Scope *s) {
+    s->marks = reserve(s->marks, &s->cap_marks, s->depth + 1, sizeof(struct Mark));
+    s->marks[s->depth++] = (struct Mark){ s->nundo, s->slot };
+}
+
+// The scope's slots are free again for the next one
+void scope_pop(Scope *s) {
+    struct Mark m = s->marks[--s->depth];
+    int to = m.undo;
+    s->slot = m.slot;
+    while (s->nundo > to) {
+        s->nundo--;
+        s->binding[s->undo[s->nundo].name] = s->undo[s->nundo].prev;
+    }
+}
+
+// The id is taken even by a redeclaration, so a function's declarations
+// always fill the range counted for them
+int scope_declare(Scope *s, int name, int kind, int type, int flags, int line, int item) {
+    int old = s->binding[name];
+    int hidden = old >= 0 && syms.depth[old] == s->depth;
+    int id = s->next++;
+    syms.name[id] = name;
+    syms.kind[id] = kind;
+    syms.type[id] = type;
+    syms.flags[id] = flags | (hidden ? SYM_HIDDEN : 0);
+    syms.depth[id] = s->depth;
+    syms.line[id] = line;
+    syms.item[id] = item;
+    syms.uses[id] = 0;
+    syms.value[id] = NULL;
+    syms.slot[id] = -1;
+    if (hidden) return -1;
+    if (kind != S_FUNC) {
+        syms.slot[id] = s->slot++;
+        if (s->slot > s->frame) s->frame = s->slot;
+    }
+    s->undo = reserve(s->undo, &s->cap_undo, s->nundo + 1, sizeof(struct Undo));
+    s->undo[s->nundo++] = (struct Undo){ name, old };
+    s->binding[name] = id;
+    return id;
+}
+
+int scope_find(const Scope *s, int name) {
+    return s->binding[name];
+}
+
+// ---- name resolution ------------------------------------------------------
+
+static void problem(const char *what, const Node *n) {
+    sema_error(n->line, "%s '%s'", what, symbolTable[n->sym]);
+}
+
+static void declare(Sema *s, Node *n, int kind) {
+    n->decl = scope_declare(&s->scope, n->sym, kind, n->op, n->flags, n->line, s->item);
+    if (n->decl < 0) problem("redeclared name", n);
+}
+
+// A function sees the whole global scope, but only the globals declared
+// before it are visible; uses of globals are counted per worker
+static void use(Sema *s, Node *n) {
+    int id = scope_find(&s->scope, n->sym);
+    if (id >= 0 && syms.kind[id] == S_GLOBAL && syms.item[id] > s->item) id = -1;
+    n->decl = id;
+    if (id < 0) problem("undeclared name", n);
+    else if (id < syms.nglobal && s->uses) s->uses[id]++;
+    else syms.uses[id]++;
+}
+
+// The walk keeps its own stack, as deep nesting would overflow the C stack.
+// A step visits a subtree, declares a variable once its initializer has
+// been visited, or closes the scope a block or function opened.
+enum { VISIT, DECLARE, LEAVE };
+
+static void visit(Sema *s, Node *n) {
+    sema_step(s, n->next, VISIT);
+    switch (n->kind) {
+    case N_VAR:
+        sema_step(s, n, DECLARE);
+        sema_step(s, n->a, VISIT);
+        break;
+    case N_BLOCK:
+        sema_step(s, n, LEAVE);
+        sema_step(s, n->a, VISIT);
+        scope_push(&s->scope);
+        break;
+    case N_ASSIGN:
+    case N_INCR:
+    case N_READ:
+    case N_FOREACH:
+    case N_NAME:
+    case N_CALL:
+        use(s, n);
+        // fall through
+    default:
+        sema_step(s, n->d, VISIT);
+        sema_step(s, n->c, VISIT);
+        sema_step(s, n->b, VISIT);
+        sema_step(s, n->a, VISIT);
+        break;
+    }
+}
+
+void declare_function(Sema *s, Node *f) {
+    declare(s, f, S_FUNC);
+}
+
+void resolve_item(Sema *s, Node *item) {
+    Scope *sc = &s->scope;
+    if (item->kind == N_FUNC) {
+        // Declared up front; the body's statements go in the parameters' scope,
+        // which numbers its slots afresh
+        scope_push(sc);
+        sc->slot = sc->frame = 0;
+        for (Node *p = item->a; p; p = p->next) declare(s, p, S_PARAM);
+        sema_step(s, item, LEAVE);
+        if (item->b) sema_step(s, item->b->a, VISIT);
+    } else {
+        sema_step(s, item, DECLARE);
+        sema_step(s, item->a, VISIT);
+    }
+    while (s->nsteps > 0) {
+        Step st = s->steps[--s->nsteps];
+        if (st.op == VISIT) visit(s, st.n);
+        else if (st.op == DECLARE) declare(s, st.n, sc->depth == 0 ? S_GLOBAL : S_LOCAL);
+        else scope_pop(sc);
+    }
+    if (item->kind == N_FUNC && item->decl >= 0) syms.slot[item->decl] = sc->frame;
+}
+
+int warn_unused(void) {
+    int n = 0;
+    for (int id = 0; id < syms.n; id++) {
+        if (syms.uses[id] != 0 || syms.kind[id] == S_GLOBAL || syms.kind[id] == S_FUNC ||
+            (syms.flags[id] & SYM_HIDDEN))
+            continue;
+        diag("Warning: unused %s '%s' at line %d\n",
+             syms.kind[id] == S_PARAM ? "parameter" : "name",
+             symbolTable[syms.name[id]], syms.line[id]);
+        n++;
+    }
+    return n;
+}
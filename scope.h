@@ -0,0 +1,90 @@
+#ifndef SCOPE_H
+#define SCOPE_H
+
+#include "ast.h"
+
+// Block-scoped symbol table. The scanner interns names to dense ids, so the
+// name-to-declaration map is an array indexed by name id; declaring saves
+// the binding it hides in an undo log, and leaving a scope replays the log
+// back to where the scope began. Scope exit costs one step per declaration
+// made inside it, never a table copy.
+
+// Kinds of declared symbol
+enum {
+    S_GLOBAL,       // global variable or constant
+    S_FUNC,
+    S_PARAM,
+    S_LOCAL
+};
+
+// Flag on a redeclaration: it keeps its id but is never bound or used
+#define SYM_HIDDEN 0x80
+
+// Declarations, by symbol id. Each attribute is a dense array of its own,
+// so a pass that reads one attribute, such as counting uses or looking up
+// types, streams through that array alone. Every top-level item declares
+// one global, so the globals are the first nglobal ids: the functions, then
+// the variables. Each function's parameters and locals follow in a range of
+// their own, in declaration order, functions in source order.
+typedef struct {
+    int *name;              // interned name, index into symbolTable
+    unsigned char *kind;
+    int *type;              // type id (types.h); TY_* until types are checked
+    unsigned char *flags;   // F_CONST, SYM_HIDDEN
+    short *depth;           // scope nesting, 0 for globals
+    int *line;              // where it was declared
+    int *item;              // top-level item it was declared in
+    int *uses;              // names resolved to it
+    Node **value;           // a const's initializer once folded to a literal
+    int *slot;              // storage, see below
+    int n;
+    int nglobal;
+    int global_slots;       // storage the global variables take
+    int cap;
+} Symbols;
+
+// Storage is assigned as names are resolved, so nothing at run time looks
+// a variable up. A global variable has a fixed global slot, in declaration
+// order. A parameter or local has a slot in its function's frame:
+// parameters first, then each declaration the next slot free in its
+// scope, so blocks side by side share slots. A function's own slot is the
+// size of its frame.
+
+extern Symbols syms;
+
+void syms_reserve(int n);       // room for ids below n in every attribute
+
+// One thread's view of the table: what each name is bound to where it is
+typedef struct {
+    int *binding;           // by name id: visible symbol id, -1 if none
+    struct Undo *undo;      // bindings declarations replaced, by scope
+    int nundo, cap_undo;
+    struct Mark *marks;     // where each open scope began
+    int depth, cap_marks;
+    int next;               // id the next declaration gets
+    int slot;               // next free slot
+    int frame;              // most slots the function in hand has needed
+} Scope;
+
+// Start with binding's nnames entries, or none bound if it is NULL
+void scope_init(Scope *s, const int *binding, int nnames);
+void scope_free(Scope *s);
+void scope_push(Scope *s);
+void scope_pop(Scope *s);
+// New symbol for name in the innermost scope; -1 if the scope already has one
+int scope_declare(Scope *s, int name, int kind, int type, int flags, int line, int item);
+int scope_find(const Scope *s, int name);  // visible declaration, -1 if none
+
+// Name resolution, a top-level item at a time (sema.h runs the items).
+// Sets decl on declarations and uses and reports undeclared and redeclared
+// names. Functions are visible throughout the file, everything else from
+// its declaration on. Parameters share a scope with the outermost block of
+// their function.
+typedef struct Sema Sema;
+void declare_function(Sema *s, Node *f);    // hoisted before any item
+void resolve_item(Sema *s, Node *item);
+
+// Warn about locals and parameters nothing refers to; returns how many
+int warn_unused(void);
+
+#endif
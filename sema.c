@@ -0,0 +1,140 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sema.h"
+#include "types.h"
+#include "pool.h"
+#include "cache.h"
+#include "mem.h"
+
+// The scanner's name count and the parser's error count
+extern int nsymbols;
+extern int errors;
+extern int max_errors;
+
+void sema_error(int line, const char *fmt, ...) {
+    char text[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(text, sizeof(text), fmt, ap);
+    va_end(ap);
+    __atomic_add_fetch(&errors, 1, __ATOMIC_RELAXED);
+    diag("Error: %s at line %d\n", text, line);
+}
+
+// A top-level item and what was said about it: held diagnostics from
+// hoisting it, then from analyzing it
+typedef struct {
+    Node *n;
+    int base;               // a function's first parameter or local id
+    char *said[2];
+    size_t len[2];
+} Item;
+
+static Item *items;
+static int *funcs;          // items that are functions
+static Sema workers[MAX_WORKERS];
+
+static void analyze_task(int i, int w, void *arg) {
+    (void)arg;
+    Sema *s = &workers[w];
+    Item *it = &items[funcs[i]];
+    s->item = funcs[i];
+    s->scope.next = it->base;
+    diag_hold();
+    resolve_item(s, it->n);
+    check_item(s, it->n);
+    it->said[1] = diag_release(&it->len[1]);
+}
+
+// Print held messages, one per line, while the cap leaves room
+static int room, cut_short;
+
+static void emit(char *text, size_t len) {
+    size_t cut = 0;
+    while (cut < len && room > 0) {
+        const char *nl = memchr(text + cut, '\n', len - cut);
+        cut = nl ? (size_t)(nl + 1 - text) : len;
+        room--;
+    }
+    cut_short |= cut < len;
+    diag_emit(text, cut);
+    mem_free(text);
+}
+
+void analyze_program(Node *program, int jobs) {
+    room = max_errors > errors ? max_errors - errors : 0;
+    cut_short = 0;
+    int nitems = 0, nfuncs = 0;
+    for (Node *n = program; n; n = n->next) {
+        nitems++;
+        nfuncs += n->kind == N_FUNC;
+    }
+    items = mem_calloc(nitems ? nitems : 1, sizeof(Item));
+    funcs = mem_alloc((nfuncs ? nfuncs : 1) * sizeof(int));
+    nitems = nfuncs = 0;
+    for (Node *n = program; n; n = n->next) {
+        if (n->kind == N_FUNC) funcs[nfuncs++] = nitems;
+        items[nitems++].n = n;
+    }
+    if (jobs < 1) jobs = 1;
+    if (jobs > MAX_WORKERS) jobs = MAX_WORKERS;
+
+    // The global scope, on this thread: one symbol per item, the functions'
+    // first, then the variables' in order
+    Sema *s = &workers[0];
+    syms.n = syms.nglobal = syms.global_slots = 0;
+    syms_reserve(nitems);
+    scope_init(&s->scope, NULL, nsymbols);
+    for (int k = 0; k < nfuncs; k++) {
+        Item *it = &items[funcs[k]];
+        s->item = funcs[k];
+        diag_hold();
+        declare_function(s, it->n);
+        it->said[0] = diag_release(&it->len[0]);
+    }
+    check_signatures(program);
+    for (int k = 0; k < nitems; k++) {
+        if (items[k].n->kind == N_FUNC) continue;
+        s->item = k;
+        diag_hold();
+        resolve_item(s, items[k].n);
+        check_item(s, items[k].n);
+        items[k].said[1] = diag_release(&items[k].len[1]);
+    }
+    syms.nglobal = s->scope.next;
+    syms.global_slots = s->scope.slot;
+
+    // Each function's ids follow the last one's, in source order; the
+    // parser counted how many each declares
+    int next = syms.nglobal;
+    for (int k = 0; k < nfuncs; k++) {
+        items[funcs[k]].base = next;
+        next += items[funcs[k]].n->v.i;
+    }
+    syms_reserve(next);
+    syms.n = next;
+
+    for (int w = 0; w < jobs; w++) {
+        if (w > 0) scope_init(&workers[w].scope, s->scope.binding, nsymbols);
+        workers[w].uses = mem_calloc(syms.nglobal ? syms.nglobal : 1, sizeof(int));
+    }
+    pool_run(nfuncs, jobs, analyze_task, NULL);
+    for (int w = 0; w < jobs; w++) {
+        for (int id = 0; id < syms.nglobal; id++) syms.uses[id] += workers[w].uses[id];
+        mem_free(workers[w].uses);
+        mem_free(workers[w].steps);
+        scope_free(&workers[w].scope);
+        memset(&workers[w], 0, sizeof(Sema));
+    }
+
+    for (int k = 0; k < nitems; k++)
+        for (int j = 0; j < 2; j++)
+            if (items[k].said[j]) emit(items[k].said[j], items[k].len[j]);
+    // Every function was checked, so unlike a parse stopped at the cap, the
+    // count is of every error found, shown or not
+    if (cut_short) diag("Error: too many errors, giving up\n");
+    mem_free(items);
+    mem_free(funcs);
+}
@@ -0,0 +1,51 @@
+#ifndef SEMA_H
+#define SEMA_H
+
+#include "ast.h"
+#include "scope.h"
+#include "mem.h"
+
+// Semantic analysis: name resolution (scope.h) and type checking (types.h).
+// The global scope is built first on this thread: functions are hoisted,
+// their types interned, then global variables resolved and checked in
+// order. From then on it is only read, and every function is analyzed on
+// its own, on jobs threads of a work-stealing pool (pool.h); each function
+// was handed a range of symbol ids up front, so the ids are the same
+// whatever thread took it. Diagnostics are held per top-level item and
+// printed in source order, the error cap applied as they are, so the output
+// does not depend on jobs or scheduling. Messages cut by the cap end with
+// the parser's "too many errors" line.
+void analyze_program(Node *program, int jobs);
+
+// Report a semantic error at line, counted like a syntax error; the message
+// follows "Error: "
+void sema_error(int line, const char *fmt, ...);
+
+// Explicit-stack walk step; what op means is up to the walk
+typedef struct {
+    Node *n;
+    int op;
+} Step;
+
+// One worker's state, reused from function to function
+struct Sema {
+    Scope scope;
+    Step *steps;
+    int nsteps, cap_steps;
+    int *uses;              // uses of each global, added up once all are done
+    int item;               // top-level item being analyzed
+    const Node *func;       // function being checked, NULL outside one
+    int ret_type;           // its declared return type
+    int loops;              // loops the statement in hand is inside
+};
+
+static inline void sema_step(Sema *s, Node *n, int op) {
+    if (n == NULL) return;
+    if (s->nsteps == s->cap_steps) {
+        s->cap_steps = s->cap_steps ? s->cap_steps * 2 : 256;
+        s->steps = mem_realloc(s->steps, s->cap_steps * sizeof(Step));
+    }
+    s->steps[s->nsteps++] = (Step){ n, op };
+}
+
+#endif
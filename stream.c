@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "stream.h"
+#include "mem.h"
+
+// The scanner's symbol table
+extern char **symbolTable;
+extern int nsymbols;
+void create();
+int insert(char *s);
+extern int errors;
+
+// ---- writing --------------------------------------------------------------
+
+typedef struct {
+    unsigned char *p;
+    size_t n;
+    size_t cap;
+} Bytes;
+
+static void reserve(Bytes *b, size_t more) {
+    if (b->n + more <= b->cap) return;
+    while (b->n + more > b->cap) b->cap = b->cap ? b->cap * 2 : 1 << 16;
+    b->p = mem_realloc(b->p, b->cap);
+}
+
+static void put_bytes(Bytes *b, const void *s, size_t n) {
+    reserve(b, n);
+    memcpy(b->p + b->n, s, n);
+    b->n += n;
+}
+
+static void put_varint(Bytes *b, uint64_t v) {
+    reserve(b, 10);
+    while (v >= 0x80) {
+        b->p[b->n++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    b->p[b->n++] = (unsigned char)v;
+}
+
+// Named tokens start above the character range; fold them below ' '
+static int code(int kind) {
+    return kind > 256 ? kind - 256 : kind;
+}
+
+static int kind(int code) {
+    return code > 0 && code < ' ' ? code + 256 : code;
+}
+
+// Length implied by the kind, 0 if it varies
+static int fixed_len(int kind) {
+    if (kind < 256) return 1;
+    switch (kind) {
+    case EQ: case NE: case LE: case GE: case AND: case OR: case INC: case DEC: return 2;
+    }
+    return 0;
+}
+
+static uint64_t zigzag(long long v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static void put_token(Bytes *b, const Token *t, int *end, int *line) {
+    int lines = t->line - *line;
+    put_varint(b, code(t->kind));
+    put_varint(b, (uint64_t)(t->off - *end) << 2 | (lines < 3 ? lines : 3));
+    if (lines >= 3) put_varint(b, lines - 3);
+    if (!fixed_len(t->kind)) put_varint(b, t->len);
+    *end = t->off + t->len;
+    *line = t->line;
+    switch (t->kind) {
+    case ID: put_varint(b, t->val.sym); break;
+    case TYPE: put_varint(b, t->val.type); break;
+    case INT: put_varint(b, zigzag(t->val.ival)); break;
+    case REAL: {
+        uint64_t bits;
+        unsigned char le[8];
+        memcpy(&bits, &t->val.rval, 8);
+        for (int i = 0; i < 8; i++) le[i] = (unsigned char)(bits >> (8 * i));
+        put_bytes(b, le, 8);
+        break;
+    }
+    case STRING: {
+        size_t n = strlen(t->val.sval);
+        put_varint(b, n);
+        put_bytes(b, t->val.sval, n);
+        break;
+    }
+    }
+}
+
+long stream_write(const char *path, char *text, size_t len) {
+    Bytes toks = { NULL, 0, 0 }, head = { NULL, 0, 0 };
+    int saved = check_only, scan_errors = errors, end = 0, line = 1;
+    long n = 0;
+    Token t;
+    check_only = 0;     // values and symbol ids are part of the stream
+    create();
+    scan_begin(text, len, SCAN_INITIAL, 1);
+    while (scan_next(&t)) {
+        if (t.kind == TRIVIA) continue;
+        put_token(&toks, &t, &end, &line);
+        n++;
+    }
+    scan_stop();
+    check_only = saved;
+    scan_errors = errors - scan_errors;
+
+    put_bytes(&head, STREAM_MAGIC, 4);
+    put_varint(&head, STREAM_VERSION);
+    put_varint(&head, 0);
+    put_varint(&head, nsymbols);
+    for (int i = 0; i < nsymbols; i++) {
+        size_t k = strlen(symbolTable[i]);
+        put_varint(&head, k);
+        put_bytes(&head, symbolTable[i], k);
+    }
+    put_varint(&head, scan_errors);
+    put_varint(&head, n);
+    put_varint(&head, t.line);
+
+    FILE *f = fopen(path, "wb");
+    int ok = f != NULL && fwrite(head.p, 1, head.n, f) == head.n &&
+             fwrite(toks.p, 1, toks.n, f) == toks.n;
+    if (f != NULL && fclose(f) != 0) ok = 0;
+    mem_free(head.p);
+    mem_free(toks.p);
+    return ok ? n : -1;
+}
+
+// ---- reading --------------------------------------------------------------
+
+static unsigned char *data = NULL, *pos, *limit;
+static long remaining;
+static int end, line, bad;
+static int end_line;
+
+static uint64_t get_varint(void) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos == limit) break;
+        unsigned char c = *pos++;
+        v |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) return v;
+    }
+    bad = 1;
+    return 0;
+}
+
+static const unsigned char *get_bytes(size_t n) {
+    if ((size_t)(limit - pos) < n) {
+        bad = 1;
+        pos = limit;
+        return NULL;
+    }
+    pos += n;
+    return pos - n;
+}
+
+int stream_open(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return 0;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = mem_alloc(size > 0 ? size : 1);
+    size = fread(data, 1, size, f);
+    fclose(f);
+    pos = data;
+    limit = data + size;
+    bad = 0;
+
+    const unsigned char *magic = get_bytes(4);
+    if (magic == NULL || memcmp(magic, STREAM_MAGIC, 4) != 0) {
+        fprintf(stderr, "%s: not a token stream\n", path);
+        stream_close();
+        return 0;
+    }
+    uint64_t version = get_varint();
+    if (version != STREAM_VERSION) {
+        fprintf(stderr, "%s: token stream version %llu, expected %d\n", path,
+                (unsigned long long)version, STREAM_VERSION);
+        stream_close();
+        return 0;
+    }
+    get_varint();   // flags, none defined yet
+
+    // Names go back in id order, so every id in the stream stays valid
+    create();
+    uint64_t nsyms = get_varint();
+    for (uint64_t i = 0; i < nsyms && !bad; i++) {
+        uint64_t k = get_varint();
+        const unsigned char *s = get_bytes(k);
+        if (s == NULL) break;
+        char *name = mem_alloc(k + 1);
+        memcpy(name, s, k);
+        name[k] = '\0';
+        insert(name);
+        mem_free(name);
+    }
+    errors += (int)get_varint();
+    remaining = (long)get_varint();
+    end_line = (int)get_varint();
+    if (bad) {
+        fprintf(stderr, "%s: truncated token stream\n", path);
+        stream_close();
+        return 0;
+    }
+    end = 0;
+    line = 1;
+    return 1;
+}
+
+// The end token once the tokens are used up
+static int stream_end(Token *t) {
+    memset(t, 0, sizeof(Token));
+    t->off = end;
+    t->line = bad ? line : end_line;
+    return 0;
+}
+
+int stream_next(Token *t) {
+    if (remaining == 0 || data == NULL) return stream_end(t);
+    t->kind = kind((int)get_varint());
+    t->state = SCAN_INITIAL;
+    uint64_t gap = get_varint();
+    t->off = end + (int)(gap >> 2);
+    t->line = line + (int)(gap & 3);
+    if ((gap & 3) == 3) t->line += (int)get_varint();
+    t->len = fixed_len(t->kind);
+    if (t->len == 0) t->len = (int)get_varint();
+    end = t->off + t->len;
+    line = t->line;
+    switch (t->kind) {
+    case ID: t->val.sym = (int)get_varint(); break;
+    case TYPE: t->val.type = (int)get_varint(); break;
+    case INT: {
+        uint64_t z = get_varint();
+        t->val.ival = (long long)(z >> 1) ^ -(long long)(z & 1);
+        break;
+    }
+    case REAL: {
+        const unsigned char *le = get_bytes(8);
+        uint64_t bits = 0;
+        for (int i = 0; le && i < 8; i++) bits |= (uint64_t)le[i] << (8 * i);
+        memcpy(&t->val.rval, &bits, 8);
+        break;
+    }
+    case STRING: {
+        uint64_t k = get_varint();
+        const unsigned char *s = get_bytes(k);
+        t->val.sval = s && !check_only ? ast_strndup((const char *)s, k) : NULL;
+        break;
+    }
+    }
+    if (bad) {
+        fprintf(stderr, "Error: truncated token stream\n");
+        errors++;
+        remaining = 0;
+        return stream_end(t);
+    }
+    remaining--;
+    return t->kind;
+}
+
+void stream_close(void) {
+    mem_free(data);
+    data = NULL;
+}
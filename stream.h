@@ -0,0 +1,38 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stddef.h>
+
+#include "token.h"
+
+// Token stream file: the scanner's output saved for a later parse.
+//
+//     "SDTS" version flags              magic, then varints
+//     nsymbols { len bytes }...         symbol names in id order
+//     scan_errors ntokens end_line
+//     { code gap [lines] [len] [value] }...
+//
+// Every number is an unsigned LEB128 varint. code is the token kind, with
+// the named tokens (ID and up) folded down to 1..31 so each fits one byte.
+// gap is the byte distance from the end of the previous token times four
+// plus the lines since its line, capped at 3; at 3, lines holds the rest.
+// len is left out for single characters and two-character operators.
+// Values follow by kind: ID its symbol id, TYPE the type, INT the value
+// zigzag-encoded, REAL 8 bytes of the double little-endian, STRING the
+// literal's value as len bytes. Comments are not kept. end_line is the
+// line the text ends on, for the end token (token.h).
+#define STREAM_MAGIC "SDTS"
+#define STREAM_VERSION 2
+
+// Scan text[0..len) and write its tokens to path; returns the token count,
+// -1 if the file cannot be written
+long stream_write(const char *path, char *text, size_t len);
+
+// Load a stream, putting its symbols in the symbol table and adding its
+// scan errors to errors; returns 0 with a message on stderr if it is not a
+// readable stream of this version
+int stream_open(const char *path);
+int stream_next(Token *t);
+void stream_close(void);
+
+#endif
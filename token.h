@@ -0,0 +1,42 @@
+#ifndef TOKEN_H
+#define TOKEN_H
+
+#include <stddef.h>
+
+#include "ast.h"
+#include "y.tab.h"
+
+// A scanned token; offsets are relative to the buffer that was scanned
+typedef struct {
+    int kind;
+    int state;      // scanner start condition the token began in
+    int off;
+    int len;
+    int line;
+    YYSTYPE val;
+} Token;
+
+// Start condition of a scanner that is not inside a comment
+#define SCAN_INITIAL 0
+
+// Scanner side (scanner.l): text must be followed by two NUL bytes. The
+// parser is pure, so the value of the last token scanned lives here.
+// scan_next returns 0 at the end of the text, having filled in an end
+// token: kind 0, no length, on the line the text ends on. A syntax error
+// there is reported on that line, whether the tokens are scanned or
+// replayed.
+extern YYSTYPE yylval;
+extern int defer_strings;   // STRING tokens carry no value; see string_value
+void scan_buffer(char *text, size_t len, int state, int line);
+int scan_state(void);
+void scan_begin(char *text, size_t len, int state, int line);
+int scan_next(Token *t);
+void scan_stop(void);
+int scan_tokens(char *text, size_t len, int state, int line, Token **out, int *cap);
+char *string_value(const char *s, int len);
+
+// Parser side (parser.y): parse a token array as a program; t[n] is its end
+// token
+Node *parse_tokens(const char *text, const Token *t, int n, int line_base, int *errs);
+
+#endif
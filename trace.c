@@ -0,0 +1,44 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "trace.h"
+
+#define TRACE_BUF 65536     // records per write, 1 MB
+
+static FILE *out = NULL;
+static TraceRecord buf[TRACE_BUF];
+static int n = 0;
+static int failed = 0;
+
+static void flush(void) {
+    if (n > 0 && fwrite(buf, sizeof(TraceRecord), n, out) != (size_t)n) failed = 1;
+    n = 0;
+}
+
+int trace_open(const char *path) {
+    TraceHeader h = { TRACE_MAGIC, TRACE_VERSION, sizeof(TraceRecord) };
+    out = fopen(path, "wb");
+    if (out == NULL) return 0;
+    // Records already go out a megabyte at a time
+    setvbuf(out, NULL, _IONBF, 0);
+    failed = fwrite(&h, sizeof(h), 1, out) != 1;
+    return 1;
+}
+
+void trace_token(int kind, int off, int len, int sym) {
+    TraceRecord *r = &buf[n];
+    r->kind = kind;
+    r->off = off;
+    r->len = len;
+    r->sym = sym;
+    if (++n == TRACE_BUF) flush();
+}
+
+// Returns 0 if any write failed
+int trace_close(void) {
+    if (out == NULL) return 1;
+    flush();
+    failed |= fclose(out) != 0;
+    out = NULL;
+    return !failed;
+}
@@ -0,0 +1,29 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// Binary token trace (--trace FILE): a header, then one fixed-size record
+// per token the parser reads, in host byte order. tracedump renders a trace
+// as text.
+#define TRACE_MAGIC "SDTR"
+#define TRACE_VERSION 1
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t record_size;
+} TraceHeader;
+
+typedef struct {
+    int32_t kind;       // token kind as yylex returns it
+    int32_t off;        // byte offset in the input
+    int32_t len;
+    int32_t sym;        // symbol id of an ID; -1 otherwise, and under --check
+} TraceRecord;
+
+int trace_open(const char *path);
+void trace_token(int kind, int off, int len, int sym);
+int trace_close(void);
+
+#endif
@@ -0,0 +1,89 @@
+// Token trace decoder.
+//
+// Renders a binary trace written by parser --trace as one line per token:
+// offset, length, kind, symbol id and, given the source file the trace was
+// taken from, the token text.
+//
+//     tracedump TRACE [SOURCE]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "y.tab.h"
+#include "trace.h"
+
+#define K(t) case t: return #t;
+
+static const char *kind_name(int kind, char *tmp) {
+    switch (kind) {
+    K(ID) K(TYPE) K(INT) K(REAL) K(STRING) K(IF) K(ELSE) K(WHILE) K(FOR) K(FOREACH)
+    K(PRINT) K(PRINTLN) K(READ) K(RETURN) K(BREAK) K(CONTINUE) K(CONST) K(TRUE)
+    K(FALSE) K(KEYWORD) K(TRIVIA) K(EQ) K(NE) K(LE) K(GE) K(AND) K(OR) K(INC) K(DEC)
+    }
+    // Single-character tokens are their own kind
+    if (kind > ' ' && kind < 127) sprintf(tmp, "'%c'", kind);
+    else sprintf(tmp, "%d", kind);
+    return tmp;
+}
+
+static char *read_file(const char *path, long *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *text = malloc(*len + 1);
+    *len = fread(text, 1, *len, f);
+    fclose(f);
+    return text;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s TRACE [SOURCE]\n", argv[0]);
+        return 1;
+    }
+    FILE *f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+    TraceHeader h;
+    if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, TRACE_MAGIC, 4) != 0) {
+        fprintf(stderr, "%s: not a token trace\n", argv[1]);
+        return 1;
+    }
+    if (h.version != TRACE_VERSION || h.record_size != sizeof(TraceRecord)) {
+        fprintf(stderr, "%s: trace version %u, record size %u; expected %d, %zu\n", argv[1],
+                h.version, h.record_size, TRACE_VERSION, sizeof(TraceRecord));
+        return 1;
+    }
+    long len = 0;
+    char *text = NULL;
+    if (argc == 3 && (text = read_file(argv[2], &len)) == NULL) {
+        perror(argv[2]);
+        return 1;
+    }
+
+    static char out[1 << 20];
+    setvbuf(stdout, out, _IOFBF, sizeof(out));
+    printf("%10s %6s %-10s %7s  %s\n", "offset", "len", "kind", "sym", text ? "text" : "");
+    static TraceRecord r[4096];
+    size_t n;
+    long count = 0;
+    char tmp[16];
+    while ((n = fread(r, sizeof(TraceRecord), 4096, f)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            printf("%10d %6d %-10s %7d", r[i].off, r[i].len, kind_name(r[i].kind, tmp), r[i].sym);
+            if (text && r[i].off >= 0 && r[i].len >= 0 && r[i].off + (long)r[i].len <= len)
+                printf("  %.*s", r[i].len, text + r[i].off);
+            printf("\n");
+        }
+        count += n;
+    }
+    fclose(f);
+    fprintf(stderr, "%ld tokens\n", count);
+    return 0;
+}
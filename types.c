@@ -0,0 +1,401 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "types.h"
+#include "scope.h"
+#include "sema.h"
+#include "fold.h"
+#include "token.h"
+#include "mem.h"
+
+extern char **symbolTable;
+
+// ---- interned function types ----------------------------------------------
+
+static FuncType *funcs = NULL;
+static int nfuncs = 0, cap_funcs = 0;
+static int *slots = NULL;       // open addressing over funcs, id + 1 (0 = empty)
+static int nslots = 0;
+
+static unsigned int hash_func(int ret, const int *params, int n) {
+    unsigned int h = 2166136261u ^ (unsigned int)ret;
+    for (int i = 0; i < n; i++) h = (h ^ (unsigned int)params[i]) * 16777619u;
+    return h * 16777619u ^ (unsigned int)n;
+}
+
+static int same(const FuncType *f, int ret, const int *params, int n) {
+    return f->ret == ret && f->nparams == n && memcmp(f->params, params, n * sizeof(int)) == 0;
+}
+
+static unsigned int probe(int ret, const int *params, int n) {
+    unsigned int i = hash_func(ret, params, n) % nslots;
+    while (slots[i] != 0 && !same(&funcs[slots[i] - 1], ret, params, n))
+        if (++i == (unsigned int)nslots) i = 0;
+    return i;
+}
+
+void types_reset(void) {
+    for (int i = 0; i < nfuncs; i++) mem_free((void *)funcs[i].params);
+    mem_free(slots);
+    slots = NULL;
+    nfuncs = nslots = 0;
+}
+
+int type_func(int ret, const int *params, int nparams) {
+    if (2 * (nfuncs + 1) > nslots) {
+        mem_free(slots);
+        nslots = nslots ? nslots * 2 : 64;
+        slots = mem_calloc(nslots, sizeof(int));
+        for (int i = 0; i < nfuncs; i++)
+            slots[probe(funcs[i].ret, funcs[i].params, funcs[i].nparams)] = i + 1;
+    }
+    unsigned int i = probe(ret, params, nparams);
+    if (slots[i] == 0) {
+        if (nfuncs == cap_funcs) {
+            cap_funcs = cap_funcs ? cap_funcs * 2 : 64;
+            funcs = mem_realloc(funcs, cap_funcs * sizeof(FuncType));
+        }
+        int *copy = mem_alloc((nparams ? nparams : 1) * sizeof(int));
+        memcpy(copy, params, nparams * sizeof(int));
+        funcs[nfuncs] = (FuncType){ ret, nparams, copy };
+        slots[i] = ++nfuncs;
+    }
+    return NPRIM + slots[i] - 1;
+}
+
+const FuncType *func_type(int t) {
+    return t >= NPRIM && t < NPRIM + nfuncs ? &funcs[t - NPRIM] : NULL;
+}
+
+const char *type_name(int t) {
+    static const char *names[NPRIM] = {
+        "void", "int", "float", "double", "bool", "char", "string", "error"
+    };
+    return t >= 0 && t < NPRIM ? names[t] : "function";
+}
+
+// ---- checking -------------------------------------------------------------
+
+static int numeric(int t) {
+    return t == TY_INT || t == TY_CHAR || t == TY_FLOAT || t == TY_DOUBLE;
+}
+
+static int integral(int t) {
+    return t == TY_INT || t == TY_CHAR;
+}
+
+static int assignable(int to, int from) {
+    return to == T_ERROR || from == T_ERROR || (to == from && to != TY_VOID) ||
+           (numeric(to) && numeric(from));
+}
+
+static int wider(int a, int b) {
+    if (a == TY_DOUBLE || b == TY_DOUBLE) return TY_DOUBLE;
+    if (a == TY_FLOAT || b == TY_FLOAT) return TY_FLOAT;
+    return TY_INT;
+}
+
+static const char *name(const Node *n) {
+    return symbolTable[n->sym];
+}
+
+static const char *op_name(int op) {
+    switch (op) {
+    case EQ: return "==";
+    case NE: return "!=";
+    case LE: return "<=";
+    case GE: return ">=";
+    case AND: return "&&";
+    case OR: return "||";
+    case '+': return "+";
+    case '-': return "-";
+    case '*': return "*";
+    case '/': return "/";
+    case '%': return "%";
+    case '<': return "<";
+    case '>': return ">";
+    case '!': return "!";
+    default: return "?";
+    }
+}
+
+int type_of(const Node *n) {
+    switch (n->kind) {
+    case N_INT: return TY_INT;
+    case N_REAL: return TY_DOUBLE;
+    case N_STRING: return TY_STRING;
+    case N_BOOL: return TY_BOOL;
+    case N_NAME:
+        if (n->decl < 0 || syms.kind[n->decl] == S_FUNC) return T_ERROR;
+        return syms.type[n->decl];
+    case N_CALL: {
+        const FuncType *f = n->decl < 0 ? NULL : func_type(syms.type[n->decl]);
+        return f ? f->ret : T_ERROR;
+    }
+    case N_BINARY:
+    case N_UNARY:
+        return n->type;
+    default:
+        return T_ERROR;
+    }
+}
+
+static void binary(Node *n) {
+    int a = type_of(n->a), b = type_of(n->b), t = T_ERROR, ok;
+    if (a == T_ERROR || b == T_ERROR) {
+        n->type = T_ERROR;
+        return;
+    }
+    switch (n->op) {
+    case '%':
+        ok = integral(a) && integral(b);
+        t = TY_INT;
+        break;
+    case '<': case '>': case LE: case GE:
+        ok = numeric(a) && numeric(b);
+        t = TY_BOOL;
+        break;
+    case EQ: case NE:
+        ok = (numeric(a) && numeric(b)) || (a == b && a != TY_VOID);
+        t = TY_BOOL;
+        break;
+    case AND: case OR:
+        ok = a == TY_BOOL && b == TY_BOOL;
+        t = TY_BOOL;
+        break;
+    default:
+        ok = numeric(a) && numeric(b);
+        t = wider(a, b);
+        break;
+    }
+    if (!ok) {
+        sema_error(n->line, "operands of '%s' are %s and %s", op_name(n->op), type_name(a),
+                   type_name(b));
+        t = T_ERROR;
+    }
+    n->type = t;
+}
+
+static void unary(Node *n) {
+    int a = type_of(n->a);
+    if (n->op == '!') n->type = a == TY_BOOL || a == T_ERROR ? TY_BOOL : T_ERROR;
+    else n->type = numeric(a) ? wider(a, a) : T_ERROR;
+    if (n->type == T_ERROR && a != T_ERROR)
+        sema_error(n->line, "operand of '%s' is %s", op_name(n->op), type_name(a));
+}
+
+static void call(const Node *n) {
+    if (n->decl < 0) return;
+    const FuncType *f = func_type(syms.type[n->decl]);
+    if (f == NULL) {
+        sema_error(n->line, "'%s' is not a function", name(n));
+        return;
+    }
+    int k = 0;
+    for (const Node *a = n->a; a; a = a->next, k++) {
+        int t = type_of(a);
+        if (k < f->nparams && !assignable(f->params[k], t))
+            sema_error(n->line, "argument %d of '%s' is %s, not %s", k + 1, name(n),
+                       type_name(t), type_name(f->params[k]));
+    }
+    if (k != f->nparams)
+        sema_error(n->line, "'%s' takes %d argument%s, not %d", name(n), f->nparams,
+                   f->nparams == 1 ? "" : "s", k);
+}
+
+// A value read by name; functions are only called
+static void value(const Node *n) {
+    if (n->decl >= 0 && syms.kind[n->decl] == S_FUNC)
+        sema_error(n->line, "'%s' is a function, not a value", name(n));
+}
+
+// Type of the variable n assigns to, or T_ERROR once reported
+static int target(const Node *n) {
+    if (n->decl < 0) return T_ERROR;
+    if (syms.kind[n->decl] == S_FUNC) {
+        sema_error(n->line, "'%s' is a function, not a variable", name(n));
+        return T_ERROR;
+    }
+    if (syms.flags[n->decl] & F_CONST) {
+        sema_error(n->line, "assignment to const '%s'", name(n));
+        return T_ERROR;
+    }
+    return syms.type[n->decl];
+}
+
+static void assign(int line, int to, const Node *from, const char *var) {
+    int t = type_of(from);
+    if (!assignable(to, t))
+        sema_error(line, "cannot assign %s to %s '%s'", type_name(t), type_name(to), var);
+}
+
+static void condition(const Node *c) {
+    int t = type_of(c);
+    if (t != TY_BOOL && t != T_ERROR)
+        sema_error(c->line, "condition is %s, not bool", type_name(t));
+}
+
+static void ret(const Sema *s, const Node *n) {
+    int want = s->ret_type;
+    const char *f = name(s->func);
+    if (n->a == NULL) {
+        if (want != TY_VOID && want != T_ERROR)
+            sema_error(n->line, "missing return value in '%s'", f);
+        return;
+    }
+    int t = type_of(n->a);
+    if (want == TY_VOID && t != T_ERROR)
+        sema_error(n->line, "return value in void function '%s'", f);
+    else if (!assignable(want, t))
+        sema_error(n->line, "return of %s from %s function '%s'", type_name(t),
+                   type_name(want), f);
+}
+
+// The same explicit-stack walk as name resolution: DONE runs once the
+// children a step depends on have been visited, so expression types are
+// known bottom up and statements are checked in source order. A loop
+// counts as entered from its visit until LEAVE, after its body.
+enum { VISIT, DONE, LEAVE };
+
+static void visit(Sema *s, Node *n) {
+    sema_step(s, n->next, VISIT);
+    switch (n->kind) {
+    case N_IF:
+        sema_step(s, n->c, VISIT);
+        sema_step(s, n->b, VISIT);
+        sema_step(s, n, DONE);
+        sema_step(s, n->a, VISIT);
+        break;
+    case N_WHILE:
+        s->loops++;
+        sema_step(s, n, LEAVE);
+        sema_step(s, n->b, VISIT);
+        sema_step(s, n, DONE);
+        sema_step(s, n->a, VISIT);
+        break;
+    case N_FOR:
+        // a and c are simple statements, b the condition, d the body
+        s->loops++;
+        sema_step(s, n, LEAVE);
+        sema_step(s, n->d, VISIT);
+        sema_step(s, n->c, VISIT);
+        if (n->b) sema_step(s, n, DONE);
+        sema_step(s, n->b, VISIT);
+        sema_step(s, n->a, VISIT);
+        break;
+    case N_FOREACH:
+        s->loops++;
+        sema_step(s, n, LEAVE);
+        sema_step(s, n->c, VISIT);
+        sema_step(s, n, DONE);
+        sema_step(s, n->b, VISIT);
+        sema_step(s, n->a, VISIT);
+        break;
+    case N_INCR: {
+        int t = target(n);
+        if (t != T_ERROR && !numeric(t))
+            sema_error(n->line, "cannot increment %s '%s'", type_name(t), name(n));
+        break;
+    }
+    case N_READ:
+        target(n);
+        break;
+    case N_NAME:
+        value(n);
+        fold(n);
+        break;
+    default:
+        sema_step(s, n, DONE);
+        sema_step(s, n->d, VISIT);
+        sema_step(s, n->c, VISIT);
+        sema_step(s, n->b, VISIT);
+        sema_step(s, n->a, VISIT);
+        break;
+    }
+}
+
+static void done(Sema *s, Node *n) {
+    switch (n->kind) {
+    case N_VAR:
+        if (n->a) assign(n->line, n->op, n->a, name(n));
+        fold(n);
+        break;
+    case N_ASSIGN: {
+        int t = target(n);
+        if (t != T_ERROR) assign(n->line, t, n->a, name(n));
+        break;
+    }
+    case N_PRINT:
+        if (type_of(n->a) == TY_VOID) sema_error(n->line, "cannot print void");
+        break;
+    case N_RETURN:
+        ret(s, n);
+        break;
+    case N_BREAK:
+    case N_CONTINUE:
+        if (s->loops == 0)
+            sema_error(n->line, "%s outside a loop", n->kind == N_BREAK ? "break" : "continue");
+        break;
+    case N_IF:
+    case N_WHILE:
+        condition(n->a);
+        break;
+    case N_FOR:
+        condition(n->b);
+        break;
+    case N_FOREACH: {
+        int v = target(n), a = type_of(n->a), b = type_of(n->b);
+        if (v != T_ERROR && !integral(v))
+            sema_error(n->line, "foreach variable '%s' is %s, not int", name(n), type_name(v));
+        if ((a != T_ERROR && !integral(a)) || (b != T_ERROR && !integral(b)))
+            sema_error(n->line, "foreach bounds are %s and %s, not int", type_name(a),
+                       type_name(b));
+        break;
+    }
+    case N_CALL:
+        call(n);
+        break;
+    case N_BINARY:
+        binary(n);
+        fold(n);
+        break;
+    case N_UNARY:
+        unary(n);
+        fold(n);
+        break;
+    }
+}
+
+void check_signatures(Node *program) {
+    types_reset();
+    int *params = NULL, cap = 0;
+    for (Node *f = program; f; f = f->next) {
+        if (f->kind != N_FUNC || f->decl < 0) continue;
+        int k = 0;
+        for (Node *p = f->a; p; p = p->next, k++) {
+            if (k == cap) params = mem_realloc(params, (cap = cap ? cap * 2 : 8) * sizeof(int));
+            params[k] = p->op;
+        }
+        syms.type[f->decl] = type_func(f->op, params, k);
+    }
+    mem_free(params);
+}
+
+void check_item(Sema *s, Node *item) {
+    if (item->kind == N_FUNC) {
+        s->func = item;
+        s->ret_type = item->op;
+        s->loops = 0;
+        sema_step(s, item->b, VISIT);
+    } else {
+        sema_step(s, item, DONE);
+        sema_step(s, item->a, VISIT);
+    }
+    while (s->nsteps > 0) {
+        Step st = s->steps[--s->nsteps];
+        if (st.op == VISIT) visit(s, st.n);
+        else if (st.op == DONE) done(s, st.n);
+        else s->loops--;
+    }
+    s->func = NULL;
+}
@@ -0,0 +1,41 @@
+#ifndef TYPES_H
+#define TYPES_H
+
+#include "ast.h"
+
+// Interned type descriptors: equal types get equal ids, so types compare
+// as ints. The primitive types keep their TY_* values as ids, T_ERROR marks
+// an expression whose error was already reported and is accepted
+// everywhere, and function types are numbered from NPRIM on.
+enum {
+    T_ERROR = TY_STRING + 1,
+    NPRIM
+};
+
+typedef struct {
+    int ret;
+    int nparams;
+    const int *params;
+} FuncType;
+
+void types_reset(void);
+int type_func(int ret, const int *params, int nparams);
+const FuncType *func_type(int t);       // NULL unless t is a function type
+const char *type_name(int t);
+
+// Function types, interned and set on the function symbols before any
+// item is checked, as a call may come before the function
+void check_signatures(Node *program);
+
+// Infer the type of every expression in a top-level item whose names are
+// resolved and check it where it is used; sets type on operator nodes.
+// Numeric types (int, char, float, double) convert into one another; bool
+// and string only match themselves. Conditions must be bool. Constants are
+// folded as their nodes are checked (fold.h).
+typedef struct Sema Sema;
+void check_item(Sema *s, Node *item);
+
+// Type of an expression already checked
+int type_of(const Node *n);
+
+#endif
@@ -0,0 +1,258 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vm.h"
+#include "mem.h"
+
+// Calls nest at most this deep, and all their frames take at most this
+// many values
+#define MAX_FRAMES (1 << 20)
+#define MAX_STACK (1 << 24)
+
+// A caller, saved while its callee runs. Its frame is kept as an offset,
+// the stack being free to move as it grows.
+typedef struct {
+    const int *ret;         // where it continues
+    size_t locals;
+} Frame;
+
+// Strings read at run time, freed when the program ends
+typedef struct {
+    char **p;
+    int n, cap;
+} Strings;
+
+static long long to_int(double r) {
+    if (r != r) return 0;
+    if (r >= 9223372036854775807.0) return LLONG_MAX;
+    if (r <= -9223372036854775808.0) return LLONG_MIN;
+    return (long long)r;
+}
+
+static const char *read_word(Strings *read) {
+    char buf[4096];
+    if (scanf("%4095s", buf) != 1) return "";
+    if (read->n == read->cap) {
+        read->cap = read->cap ? read->cap * 2 : 16;
+        read->p = mem_realloc(read->p, read->cap * sizeof(char *));
+    }
+    size_t len = strlen(buf);
+    char *s = mem_alloc(len + 1);
+    memcpy(s, buf, len + 1);
+    return read->p[read->n++] = s;
+}
+
+int vm_run(const Program *p) {
+    static void *const dispatch[] = {
+#define OP_LABEL(name, operands, effect) &&do_##name,
+        OPCODES(OP_LABEL)
+#undef OP_LABEL
+    };
+    const int *code = p->code, *pc = code;
+    const Value *consts = p->consts;
+    Value *globals = mem_calloc(p->nglobals ? p->nglobals : 1, sizeof(Value));
+    // One stack holds every call's frame with its operands above it
+    size_t cap = 1024 + p->maxstack;
+    Value *stack = mem_alloc(cap * sizeof(Value)), *sp = stack;
+    Value *locals = stack;
+    Frame *frames = NULL;
+    int nframes = 0, cap_frames = 0;
+    Strings read = { 0 };
+    int status = 0;
+    const char *error = NULL;
+
+#define NEXT goto *dispatch[*pc++]
+#define BINARY(field, expr) \
+    sp--; \
+    sp[-1].field = (expr); \
+    NEXT
+    NEXT;
+
+do_HALT:
+    goto done;
+do_PUSH:
+    *sp++ = consts[*pc++];
+    NEXT;
+do_POP:
+    sp--;
+    NEXT;
+do_LOAD_G:
+    *sp++ = globals[*pc++];
+    NEXT;
+do_STORE_G:
+    globals[*pc++] = *--sp;
+    NEXT;
+do_LOAD_L:
+    *sp++ = locals[*pc++];
+    NEXT;
+do_STORE_L:
+    locals[*pc++] = *--sp;
+    NEXT;
+
+    // Integer arithmetic wraps, as on the machine
+do_ADD_I: BINARY(i, (long long)((unsigned long long)sp[-1].i + (unsigned long long)sp[0].i));
+do_SUB_I: BINARY(i, (long long)((unsigned long long)sp[-1].i - (unsigned long long)sp[0].i));
+do_MUL_I: BINARY(i, (long long)((unsigned long long)sp[-1].i * (unsigned long long)sp[0].i));
+do_DIV_I:
+    if (sp[-1].i == 0) goto divide_by_zero;
+    BINARY(i, sp[0].i == -1 ? (long long)(0 - (unsigned long long)sp[-1].i)
+                            : sp[-1].i / sp[0].i);
+do_MOD_I:
+    if (sp[-1].i == 0) goto divide_by_zero;
+    BINARY(i, sp[0].i == -1 ? 0 : sp[-1].i % sp[0].i);
+do_NEG_I:
+    sp[-1].i = (long long)(0 - (unsigned long long)sp[-1].i);
+    NEXT;
+do_ADD_F: BINARY(r, sp[-1].r + sp[0].r);
+do_SUB_F: BINARY(r, sp[-1].r - sp[0].r);
+do_MUL_F: BINARY(r, sp[-1].r * sp[0].r);
+do_DIV_F: BINARY(r, sp[-1].r / sp[0].r);
+do_NEG_F:
+    sp[-1].r = -sp[-1].r;
+    NEXT;
+do_LT_I: BINARY(i, sp[-1].i < sp[0].i);
+do_LE_I: BINARY(i, sp[-1].i <= sp[0].i);
+do_GT_I: BINARY(i, sp[-1].i > sp[0].i);
+do_GE_I: BINARY(i, sp[-1].i >= sp[0].i);
+do_EQ_I: BINARY(i, sp[-1].i == sp[0].i);
+do_NE_I: BINARY(i, sp[-1].i != sp[0].i);
+do_LT_F: BINARY(i, sp[-1].r < sp[0].r);
+do_LE_F: BINARY(i, sp[-1].r <= sp[0].r);
+do_GT_F: BINARY(i, sp[-1].r > sp[0].r);
+do_GE_F: BINARY(i, sp[-1].r >= sp[0].r);
+do_EQ_F: BINARY(i, sp[-1].r == sp[0].r);
+do_NE_F: BINARY(i, sp[-1].r != sp[0].r);
+do_EQ_S: BINARY(i, strcmp(sp[-1].s, sp[0].s) == 0);
+do_NE_S: BINARY(i, strcmp(sp[-1].s, sp[0].s) != 0);
+do_NOT:
+    sp[-1].i = !sp[-1].i;
+    NEXT;
+do_I2F:
+    sp[-1].r = (double)sp[-1].i;
+    NEXT;
+do_F2I:
+    sp[-1].i = to_int(sp[-1].r);
+    NEXT;
+do_TO_FLOAT:
+    sp[-1].r = (float)sp[-1].r;
+    NEXT;
+do_TO_CHAR:
+    sp[-1].i = (signed char)sp[-1].i;
+    NEXT;
+
+do_JUMP:
+    pc = code + *pc;
+    NEXT;
+do_JZ:
+    pc = (--sp)->i == 0 ? code + *pc : pc + 1;
+    NEXT;
+do_JNZ:
+    pc = (--sp)->i != 0 ? code + *pc : pc + 1;
+    NEXT;
+do_DIR: BINARY(i, sp[-1].i <= sp[0].i ? 1 : -1);
+do_PAST:
+    sp -= 2;
+    sp[-1].i = sp[1].i > 0 ? sp[-1].i > sp[0].i : sp[-1].i < sp[0].i;
+    NEXT;
+
+do_CALL: {
+    const Func *f = &p->funcs[*pc++];
+    if (nframes == cap_frames) {
+        if (nframes == MAX_FRAMES) goto stack_overflow;
+        cap_frames = cap_frames ? cap_frames * 2 : 256;
+        frames = mem_realloc(frames, cap_frames * sizeof(Frame));
+    }
+    frames[nframes++] = (Frame){ pc, locals - stack };
+    // The arguments, where the caller pushed them, are the first slots of
+    // the frame; the rest are stored before they are read (compile.c)
+    size_t at = sp - stack - f->nparams;
+    if (at + f->nslots + f->maxstack > cap) {
+        if (at + f->nslots + f->maxstack > MAX_STACK) goto stack_overflow;
+        while (at + f->nslots + f->maxstack > cap) cap *= 2;
+        stack = mem_realloc(stack, cap * sizeof(Value));
+    }
+    locals = stack + at;
+    sp = locals + f->nslots;
+    pc = code + f->entry;
+    NEXT;
+}
+    // The result replaces the arguments
+do_RET:
+    *locals = sp[-1];
+    sp = locals + 1;
+    locals = stack + frames[--nframes].locals;
+    pc = frames[nframes].ret;
+    NEXT;
+do_RET_VOID:
+    sp = locals;
+    locals = stack + frames[--nframes].locals;
+    pc = frames[nframes].ret;
+    NEXT;
+
+do_PRINT_I:
+    printf("%lld", (--sp)->i);
+    NEXT;
+do_PRINT_F:
+    printf("%g", (--sp)->r);
+    NEXT;
+do_PRINT_B:
+    fputs((--sp)->i ? "true" : "false", stdout);
+    NEXT;
+do_PRINT_C:
+    putchar((int)(--sp)->i);
+    NEXT;
+do_PRINT_S:
+    fputs((--sp)->s, stdout);
+    NEXT;
+do_NEWLINE:
+    putchar('\n');
+    NEXT;
+do_READ_I:
+    sp->i = 0;
+    if (scanf("%lld", &sp->i) != 1) sp->i = 0;
+    sp++;
+    NEXT;
+do_READ_F:
+    sp->r = 0;
+    if (scanf("%lf", &sp->r) != 1) sp->r = 0;
+    sp++;
+    NEXT;
+do_READ_B: {
+    const char *w = read_word(&read);
+    (sp++)->i = strcmp(w, "true") == 0 || atoll(w) != 0;
+    NEXT;
+}
+do_READ_C: {
+    int c = getchar();
+    (sp++)->i = c == EOF ? 0 : (signed char)c;
+    NEXT;
+}
+do_READ_S:
+    (sp++)->s = read_word(&read);
+    NEXT;
+
+divide_by_zero:
+    error = "division by zero";
+    pc--;
+    goto fail;
+stack_overflow:
+    error = "stack overflow";
+    pc -= 2;
+    goto fail;
+fail:
+    fflush(stdout);
+    fprintf(stderr, "Runtime error: %s at line %d\n", error, p->lines[pc - code]);
+    status = 1;
+done:
+    fflush(stdout);
+    mem_free(frames);
+    mem_free(stack);
+    mem_free(globals);
+    for (int i = 0; i < read.n; i++) mem_free(read.p[i]);
+    mem_free(read.p);
+    return status;
+#undef NEXT
+#undef BINARY
+}
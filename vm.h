@@ -0,0 +1,12 @@
+#ifndef VM_H
+#define VM_H
+
+#include "code.h"
+
+// Run a compiled program: initialize its globals and call main. Dispatch
+// is threaded through a table of label addresses (GNU C computed goto), so
+// each instruction ends in its own indirect jump to the next. Returns 0, or
+// 1 after reporting a run-time error on stderr.
+int vm_run(const Program *p);
+
+#endif
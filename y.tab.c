@@ -55,7 +55,7 @@
 #define YYSKELETON_NAME "yacc.c"
 
 /* Pure parsers.  */
-#define YYPURE 0
+#define YYPURE 2
 
 /* Push parsers.  */
 #define YYPUSH 0
@@ -72,20 +72,120 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+// Instrumented builds count reductions in bison's reduce step: make builds
+// them from a copy of y.tab.c with PROFILE_REDUCE after its YY_REDUCE_PRINT.
+// YYDEBUG is on only for the rule names and lines; yydebug stays 0, so no
+// trace is printed.
+#ifdef PROFILE
+#define YYDEBUG 1
+#define PROFILE_REDUCE(Rule) profile_reduce(Rule)
+static void profile_reduce(int rule);
+#endif
+
+#include "ast.h"
+#include "token.h"
+#include "incr.h"
+#include "phase.h"
+#include "mem.h"
+#include "profile.h"
+#include "trace.h"
+#include "stream.h"
+#include "cache.h"
+#include "pipeline.h"
+#include "parallel.h"
+#include "scope.h"
+#include "sema.h"
+#include "code.h"
+#include "vm.h"
 
 // get token that recognized by scanner
-extern int yylex();
+extern int scan();
 extern int yyparse();
 extern FILE *yyin;
 
 // Add a global variable to store the token text
 extern char *yytext;
-
+extern int yyleng;
+extern int linenum;
+// Line of the token the parser read last; the scanner's linenum may be ahead.
+// This and the rest of the parser's state are per thread, for --jobs.
+static _Thread_local int tokline = 1;
+// Parameters and variables declared since the last top-level item, which a
+// function keeps as its count of symbol ids (sema.h)
+static _Thread_local int decls;
+extern int scan_offset;
+extern char **symbolTable;
+
+// --check: accept/reject only, no tree, no symbol text, no token output
+int check_only = 0;
+int trace = 0;      // --trace FILE: record every token as it is read
+static int quiet = 0;       // --quiet: full parse, nothing echoed
+static int scan_only = 0;   // --scan-only: count tokens, no parse
+static int from_tokens = 0; // --from-tokens: the input is a token stream
+static int pipeline = 0;    // --pipeline: scan on a second thread
+static int jobs = 0;        // --jobs N: parse top-level items on N threads
+static int sema_jobs = 1;   // and analyze functions on N threads
+static int unused = 0;      // --warn-unused: report unreferenced locals
+static int run = 0;         // --run: compile and execute, nothing echoed
+extern int listing;
+
+// Pre-scanned tokens replayed instead of calling the scanner; replay_text is
+// the text their offsets point into, NULL for a token stream file
+static _Thread_local const char *replay_text;
+static _Thread_local const Token *replay, *replay_end;
+static _Thread_local int replay_base;
+
+// Syntax errors reported so far; parsing stops once the errors counted for
+// this parse reach max_errors
+int errors = 0;
+int max_errors = 20;
+static _Thread_local int *counted = &errors;
+
+// The parser stacks start at YYINITDEPTH entries and double on the heap as
+// nesting deepens; the only cap is this budget in bytes (--stack-budget)
+long stack_budget = 256L << 20;
+#define YYMAXDEPTH (stack_budget / (long) (sizeof(yy_state_t) + sizeof(YYSTYPE)))
+#define YYMALLOC mem_alloc
+#define YYFREE mem_free
+
+int yylex(YYSTYPE *lval);
+
+// The scanner may be counting errors too, on its own thread (--pipeline)
 void yyerror(const char *s) {
-    fprintf(stderr, "Error: %s\n", s);
+    int e = __atomic_add_fetch(counted, 1, __ATOMIC_RELAXED);
+    if (e > max_errors) return;
+    if (replay && replay_text == NULL) {
+        // Without the text, only names and single characters can be shown
+        const Token *t = &replay[-1];
+        char one[2] = { t->kind > 0 && t->kind < 256 ? t->kind : 0, '\0' };
+        diag("Error: %s at line %d near '%s'\n", s, replay_base + tokline,
+             t->kind == ID ? symbolTable[t->val.sym] : one);
+    } else if (replay) {
+        const Token *t = replay[-1].kind ? &replay[-1] : NULL;
+        diag("Error: %s at line %d near '%.*s'\n", s, replay_base + tokline,
+             t ? t->len : 0, t ? replay_text + t->off : "");
+    } else {
+        diag("Error: %s at line %d near '%s'\n", s, tokline, yytext);
+    }
+    if (e == max_errors)
+        diag("Error: too many errors, giving up\n");
+}
+
+// After resynchronizing: report the next error right away, unless capped
+#define RECOVER { yyerrok; if (__atomic_load_n(counted, __ATOMIC_RELAXED) >= max_errors) YYABORT; }
+
+// Declarations carry their type on every declared variable
+static List typed(List vars, int type, int flags) {
+    for (Node *n = vars.head; n; n = n->next) {
+        n->op = type;
+        n->flags |= flags;
+    }
+    return vars;
 }
 
-#line 89 "y.tab.c"
+#line 189 "y.tab.c"
 
 # ifndef YY_CAST
 #  ifdef __cplusplus
@@ -129,20 +229,37 @@ extern int yydebug;
     YYEOF = 0,                     /* "end of file"  */
     YYerror = 256,                 /* error  */
     YYUNDEF = 257,                 /* "invalid token"  */
-    VOID = 258,                    /* VOID  */
-    MAIN = 259,                    /* MAIN  */
-    IF = 260,                      /* IF  */
-    ELSE = 261,                    /* ELSE  */
-    WHILE = 262,                   /* WHILE  */
-    PRINT = 263,                   /* PRINT  */
-    RETURN = 264,                  /* RETURN  */
-    ID = 265,                      /* ID  */
-    INT = 266,                     /* INT  */
-    REAL = 267,                    /* REAL  */
-    STRING = 268,                  /* STRING  */
-    OP = 269,                      /* OP  */
-    DELIM = 270,                   /* DELIM  */
-    KEYWORD = 271                  /* KEYWORD  */
+    ID = 258,                      /* ID  */
+    TYPE = 259,                    /* TYPE  */
+    INT = 260,                     /* INT  */
+    REAL = 261,                    /* REAL  */
+    STRING = 262,                  /* STRING  */
+    IF = 263,                      /* IF  */
+    ELSE = 264,                    /* ELSE  */
+    WHILE = 265,                   /* WHILE  */
+    FOR = 266,                     /* FOR  */
+    FOREACH = 267,                 /* FOREACH  */
+    PRINT = 268,                   /* PRINT  */
+    PRINTLN = 269,                 /* PRINTLN  */
+    READ = 270,                    /* READ  */
+    RETURN = 271,                  /* RETURN  */
+    BREAK = 272,                   /* BREAK  */
+    CONTINUE = 273,                /* CONTINUE  */
+    CONST = 274,                   /* CONST  */
+    TRUE = 275,                    /* TRUE  */
+    FALSE = 276,                   /* FALSE  */
+    KEYWORD = 277,                 /* KEYWORD  */
+    TRIVIA = 278,                  /* TRIVIA  */
+    EQ = 279,                      /* EQ  */
+    NE = 280,                      /* NE  */
+    LE = 281,                      /* LE  */
+    GE = 282,                      /* GE  */
+    AND = 283,                     /* AND  */
+    OR = 284,                      /* OR  */
+    INC = 285,                     /* INC  */
+    DEC = 286,                     /* DEC  */
+    UMINUS = 287,                  /* UMINUS  */
+    LOWER_THAN_ELSE = 288          /* LOWER_THAN_ELSE  */
   };
   typedef enum yytokentype yytoken_kind_t;
 #endif
@@ -151,30 +268,61 @@ extern int yydebug;
 #define YYEOF 0
 #define YYerror 256
 #define YYUNDEF 257
-#define VOID 258
-#define MAIN 259
-#define IF 260
-#define ELSE 261
-#define WHILE 262
-#define PRINT 263
-#define RETURN 264
-#define ID 265
-#define INT 266
-#define REAL 267
-#define STRING 268
-#define OP 269
-#define DELIM 270
-#define KEYWORD 271
+#define ID 258
+#define TYPE 259
+#define INT 260
+#define REAL 261
+#define STRING 262
+#define IF 263
+#define ELSE 264
+#define WHILE 265
+#define FOR 266
+#define FOREACH 267
+#define PRINT 268
+#define PRINTLN 269
+#define READ 270
+#define RETURN 271
+#define BREAK 272
+#define CONTINUE 273
+#define CONST 274
+#define TRUE 275
+#define FALSE 276
+#define KEYWORD 277
+#define TRIVIA 278
+#define EQ 279
+#define NE 280
+#define LE 281
+#define GE 282
+#define AND 283
+#define OR 284
+#define INC 285
+#define DEC 286
+#define UMINUS 287
+#define LOWER_THAN_ELSE 288
 
 /* Value type.  */
 #if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
-typedef int YYSTYPE;
+union YYSTYPE
+{
+#line 121 "parser.y"
+
+    long long ival;
+    double rval;
+    char *sval;
+    int sym;
+    int type;
+    Node *node;
+    List list;
+
+#line 318 "y.tab.c"
+
+};
+typedef union YYSTYPE YYSTYPE;
 # define YYSTYPE_IS_TRIVIAL 1
 # define YYSTYPE_IS_DECLARED 1
 #endif
 
 
-extern YYSTYPE yylval;
 
 
 int yyparse (void);
@@ -188,38 +336,74 @@ enum yysymbol_kind_t
   YYSYMBOL_YYEOF = 0,                      /* "end of file"  */
   YYSYMBOL_YYerror = 1,                    /* error  */
   YYSYMBOL_YYUNDEF = 2,                    /* "invalid token"  */
-  YYSYMBOL_VOID = 3,                       /* VOID  */
-  YYSYMBOL_MAIN = 4,                       /* MAIN  */
-  YYSYMBOL_IF = 5,                         /* IF  */
-  YYSYMBOL_ELSE = 6,                       /* ELSE  */
-  YYSYMBOL_WHILE = 7,                      /* WHILE  */
-  YYSYMBOL_PRINT = 8,                      /* PRINT  */
-  YYSYMBOL_RETURN = 9,                     /* RETURN  */
-  YYSYMBOL_ID = 10,                        /* ID  */
-  YYSYMBOL_INT = 11,                       /* INT  */
-  YYSYMBOL_REAL = 12,                      /* REAL  */
-  YYSYMBOL_STRING = 13,                    /* STRING  */
-  YYSYMBOL_OP = 14,                        /* OP  */
-  YYSYMBOL_DELIM = 15,                     /* DELIM  */
-  YYSYMBOL_KEYWORD = 16,                   /* KEYWORD  */
-  YYSYMBOL_17_ = 17,                       /* ';'  */
-  YYSYMBOL_18_ = 18,                       /* '='  */
-  YYSYMBOL_19_ = 19,                       /* '('  */
-  YYSYMBOL_20_ = 20,                       /* ')'  */
-  YYSYMBOL_21_ = 21,                       /* '{'  */
-  YYSYMBOL_22_ = 22,                       /* '}'  */
-  YYSYMBOL_YYACCEPT = 23,                  /* $accept  */
-  YYSYMBOL_program = 24,                   /* program  */
-  YYSYMBOL_declarations = 25,              /* declarations  */
-  YYSYMBOL_declaration = 26,               /* declaration  */
-  YYSYMBOL_main_function = 27,             /* main_function  */
-  YYSYMBOL_block = 28,                     /* block  */
-  YYSYMBOL_statements = 29,                /* statements  */
-  YYSYMBOL_statement = 30,                 /* statement  */
-  YYSYMBOL_assignment = 31,                /* assignment  */
-  YYSYMBOL_print_statement = 32,           /* print_statement  */
-  YYSYMBOL_conditional = 33,               /* conditional  */
-  YYSYMBOL_expression = 34                 /* expression  */
+  YYSYMBOL_ID = 3,                         /* ID  */
+  YYSYMBOL_TYPE = 4,                       /* TYPE  */
+  YYSYMBOL_INT = 5,                        /* INT  */
+  YYSYMBOL_REAL = 6,                       /* REAL  */
+  YYSYMBOL_STRING = 7,                     /* STRING  */
+  YYSYMBOL_IF = 8,                         /* IF  */
+  YYSYMBOL_ELSE = 9,                       /* ELSE  */
+  YYSYMBOL_WHILE = 10,                     /* WHILE  */
+  YYSYMBOL_FOR = 11,                       /* FOR  */
+  YYSYMBOL_FOREACH = 12,                   /* FOREACH  */
+  YYSYMBOL_PRINT = 13,                     /* PRINT  */
+  YYSYMBOL_PRINTLN = 14,                   /* PRINTLN  */
+  YYSYMBOL_READ = 15,                      /* READ  */
+  YYSYMBOL_RETURN = 16,                    /* RETURN  */
+  YYSYMBOL_BREAK = 17,                     /* BREAK  */
+  YYSYMBOL_CONTINUE = 18,                  /* CONTINUE  */
+  YYSYMBOL_CONST = 19,                     /* CONST  */
+  YYSYMBOL_TRUE = 20,                      /* TRUE  */
+  YYSYMBOL_FALSE = 21,                     /* FALSE  */
+  YYSYMBOL_KEYWORD = 22,                   /* KEYWORD  */
+  YYSYMBOL_TRIVIA = 23,                    /* TRIVIA  */
+  YYSYMBOL_EQ = 24,                        /* EQ  */
+  YYSYMBOL_NE = 25,                        /* NE  */
+  YYSYMBOL_LE = 26,                        /* LE  */
+  YYSYMBOL_GE = 27,                        /* GE  */
+  YYSYMBOL_AND = 28,                       /* AND  */
+  YYSYMBOL_OR = 29,                        /* OR  */
+  YYSYMBOL_INC = 30,                       /* INC  */
+  YYSYMBOL_DEC = 31,                       /* DEC  */
+  YYSYMBOL_32_ = 32,                       /* '<'  */
+  YYSYMBOL_33_ = 33,                       /* '>'  */
+  YYSYMBOL_34_ = 34,                       /* '+'  */
+  YYSYMBOL_35_ = 35,                       /* '-'  */
+  YYSYMBOL_36_ = 36,                       /* '*'  */
+  YYSYMBOL_37_ = 37,                       /* '/'  */
+  YYSYMBOL_38_ = 38,                       /* '%'  */
+  YYSYMBOL_39_ = 39,                       /* '!'  */
+  YYSYMBOL_UMINUS = 40,                    /* UMINUS  */
+  YYSYMBOL_LOWER_THAN_ELSE = 41,           /* LOWER_THAN_ELSE  */
+  YYSYMBOL_42_ = 42,                       /* ';'  */
+  YYSYMBOL_43_ = 43,                       /* '}'  */
+  YYSYMBOL_44_ = 44,                       /* ','  */
+  YYSYMBOL_45_ = 45,                       /* '='  */
+  YYSYMBOL_46_ = 46,                       /* '('  */
+  YYSYMBOL_47_ = 47,                       /* ')'  */
+  YYSYMBOL_48_ = 48,                       /* '{'  */
+  YYSYMBOL_49_ = 49,                       /* ':'  */
+  YYSYMBOL_50_ = 50,                       /* '.'  */
+  YYSYMBOL_YYACCEPT = 51,                  /* $accept  */
+  YYSYMBOL_program = 52,                   /* program  */
+  YYSYMBOL_items = 53,                     /* items  */
+  YYSYMBOL_declaration = 54,               /* declaration  */
+  YYSYMBOL_init_list = 55,                 /* init_list  */
+  YYSYMBOL_init = 56,                      /* init  */
+  YYSYMBOL_function = 57,                  /* function  */
+  YYSYMBOL_params = 58,                    /* params  */
+  YYSYMBOL_param_list = 59,                /* param_list  */
+  YYSYMBOL_param = 60,                     /* param  */
+  YYSYMBOL_block = 61,                     /* block  */
+  YYSYMBOL_stmts = 62,                     /* stmts  */
+  YYSYMBOL_stmt = 63,                      /* stmt  */
+  YYSYMBOL_simple = 64,                    /* simple  */
+  YYSYMBOL_opt_simple = 65,                /* opt_simple  */
+  YYSYMBOL_opt_expr = 66,                  /* opt_expr  */
+  YYSYMBOL_call = 67,                      /* call  */
+  YYSYMBOL_args = 68,                      /* args  */
+  YYSYMBOL_arg_list = 69,                  /* arg_list  */
+  YYSYMBOL_expression = 70                 /* expression  */
 };
 typedef enum yysymbol_kind_t yysymbol_kind_t;
 
@@ -336,7 +520,7 @@ typedef int yytype_uint16;
 
 
 /* Stored state numbers (used for stacks). */
-typedef yytype_int8 yy_state_t;
+typedef yytype_uint8 yy_state_t;
 
 /* State numbers in computations.  */
 typedef int yy_state_fast_t;
@@ -545,21 +729,21 @@ union yyalloc
 #endif /* !YYCOPY_NEEDED */
 
 /* YYFINAL -- State number of the termination state.  */
-#define YYFINAL  7
+#define YYFINAL  3
 /* YYLAST -- Last index in YYTABLE.  */
-#define YYLAST   45
+#define YYLAST   324
 
 /* YYNTOKENS -- Number of terminals.  */
-#define YYNTOKENS  23
+#define YYNTOKENS  51
 /* YYNNTS -- Number of nonterminals.  */
-#define YYNNTS  12
+#define YYNNTS  20
 /* YYNRULES -- Number of rules.  */
-#define YYNRULES  24
+#define YYNRULES  80
 /* YYNSTATES -- Number of states.  */
-#define YYNSTATES  50
+#define YYNSTATES  160
 
 /* YYMAXUTOK -- Last valid token kind.  */
-#define YYMAXUTOK   271
+#define YYMAXUTOK   288
 
 
 /* YYTRANSLATE(TOKEN-NUM) -- Symbol number corresponding to TOKEN-NUM
@@ -576,16 +760,16 @@ static const yytype_int8 yytranslate[] =
        0,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-      19,    20,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,    17,
-       2,    18,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,    39,     2,     2,     2,    38,     2,     2,
+      46,    47,    36,    34,    44,    35,    50,    37,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,    49,    42,
+      32,    45,    33,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,    21,     2,    22,     2,     2,     2,     2,
+       2,     2,     2,    48,     2,    43,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
@@ -600,16 +784,23 @@ static const yytype_int8 yytranslate[] =
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     1,     2,     3,     4,
        5,     6,     7,     8,     9,    10,    11,    12,    13,    14,
-      15,    16
+      15,    16,    17,    18,    19,    20,    21,    22,    23,    24,
+      25,    26,    27,    28,    29,    30,    31,    40,    41
 };
 
 #if YYDEBUG
 /* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
-static const yytype_int8 yyrline[] =
+static const yytype_int16 yyrline[] =
 {
-       0,    27,    27,    28,    32,    33,    37,    38,    42,    46,
-      50,    51,    55,    56,    57,    61,    65,    69,    70,    74,
-      75,    76,    77,    78,    79
+       0,   161,   161,   165,   166,   167,   168,   169,   170,   174,
+     175,   176,   177,   181,   182,   186,   187,   195,   199,   206,
+     207,   211,   212,   216,   221,   229,   230,   237,   238,   239,
+     243,   244,   245,   246,   247,   248,   249,   250,   253,   257,
+     258,   262,   266,   267,   268,   272,   276,   280,   284,   288,
+     289,   293,   294,   298,   305,   306,   310,   311,   315,   319,
+     323,   327,   331,   332,   333,   334,   335,   336,   337,   338,
+     339,   340,   341,   342,   343,   344,   345,   346,   347,   348,
+     349
 };
 #endif
 
@@ -625,12 +816,16 @@ static const char *yysymbol_name (yysymbol_kind_t yysymbol) YY_ATTRIBUTE_UNUSED;
    First, the terminals, then, starting at YYNTOKENS, nonterminals.  */
 static const char *const yytname[] =
 {
-  "\"end of file\"", "error", "\"invalid token\"", "VOID", "MAIN", "IF",
-  "ELSE", "WHILE", "PRINT", "RETURN", "ID", "INT", "REAL", "STRING", "OP",
-  "DELIM", "KEYWORD", "';'", "'='", "'('", "')'", "'{'", "'}'", "$accept",
-  "program", "declarations", "declaration", "main_function", "block",
-  "statements", "statement", "assignment", "print_statement",
-  "conditional", "expression", YY_NULLPTR
+  "\"end of file\"", "error", "\"invalid token\"", "ID", "TYPE", "INT",
+  "REAL", "STRING", "IF", "ELSE", "WHILE", "FOR", "FOREACH", "PRINT",
+  "PRINTLN", "READ", "RETURN", "BREAK", "CONTINUE", "CONST", "TRUE",
+  "FALSE", "KEYWORD", "TRIVIA", "EQ", "NE", "LE", "GE", "AND", "OR", "INC",
+  "DEC", "'<'", "'>'", "'+'", "'-'", "'*'", "'/'", "'%'", "'!'", "UMINUS",
+  "LOWER_THAN_ELSE", "';'", "'}'", "','", "'='", "'('", "')'", "'{'",
+  "':'", "'.'", "$accept", "program", "items", "declaration", "init_list",
+  "init", "function", "params", "param_list", "param", "block", "stmts",
+  "stmt", "simple", "opt_simple", "opt_expr", "call", "args", "arg_list",
+  "expression", YY_NULLPTR
 };
 
 static const char *
@@ -640,25 +835,36 @@ yysymbol_name (yysymbol_kind_t yysymbol)
 }
 #endif
 
-#define YYPACT_NINF (-19)
+#define YYPACT_NINF (-88)
 
 #define yypact_value_is_default(Yyn) \
   ((Yyn) == YYPACT_NINF)
 
-#define YYTABLE_NINF (-6)
+#define YYTABLE_NINF (-3)
 
 #define yytable_value_is_error(Yyn) \
   0
 
 /* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
    STATE-NUM.  */
-static const yytype_int8 yypact[] =
+static const yytype_int16 yypact[] =
 {
-       0,   -19,    -8,    24,     6,     3,    16,   -19,    27,   -19,
-     -19,   -19,    -5,    17,   -19,   -19,   -19,   -19,    -5,     9,
-      15,    -3,    -5,   -19,    18,   -19,    23,    10,   -19,    19,
-      -5,    22,    20,    10,   -19,   -19,   -19,    -5,    11,    -5,
-     -19,   -19,     2,   -19,    13,    18,   -19,    35,    18,   -19
+     -88,     4,    45,   -88,    58,   -38,    89,     5,   -88,   -88,
+     -88,   -88,   -88,   -88,   109,   -31,    69,    54,   -88,   -18,
+      44,    22,   -88,    51,    12,    25,   -88,   -88,    88,   109,
+     -88,    44,   -88,    18,    55,    68,    57,   104,    20,    27,
+      43,    72,    88,    88,   119,    88,    82,    83,   -88,   -88,
+     -88,   -88,    84,   -88,   -88,    80,   109,    85,   -88,   -88,
+     -88,   -88,   -88,    88,    88,    88,   -88,   238,    90,   -88,
+     -88,   -88,   -88,   -88,   -88,   -88,    88,    88,    88,    88,
+     129,   133,   200,   219,    97,   105,   238,   -88,   -88,   -88,
+     -88,   -88,   -88,   -88,   136,    88,    88,    88,    88,    88,
+      88,    88,    88,    88,    88,    88,    88,    88,    80,   238,
+     101,   112,   238,   152,   168,   -88,   115,   110,   -88,   -88,
+     -88,   -88,   -88,   281,   281,   286,   286,   268,   253,   286,
+     286,    -9,    -9,   -88,   -88,   -88,   -88,   -88,    88,     2,
+       2,    88,    88,   238,    19,   149,   -88,   124,   117,     2,
+     129,   125,   -88,   135,    88,     2,   184,   -88,     2,   -88
 };
 
 /* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
@@ -666,73 +872,163 @@ static const yytype_int8 yypact[] =
    means the default is an error.  */
 static const yytype_int8 yydefact[] =
 {
-       0,     3,     0,     0,     0,     5,     0,     1,     0,     2,
-       4,     6,     0,     0,    22,    19,    20,    21,     0,     0,
-       0,     0,     0,     7,     0,    23,    24,    11,     8,     0,
-       0,     0,     0,    11,    12,    13,    14,     0,     0,     0,
-       9,    10,     0,    16,     0,     0,    15,    17,     0,    18
+       3,     0,     0,     1,     0,     0,     0,     0,     4,     5,
+       6,     7,    27,     8,    19,     0,    15,     0,    13,     0,
+       0,     0,    24,     0,     0,    20,    21,    11,     0,    19,
+       9,     0,    12,    15,     0,     0,     0,     0,     0,     0,
+       0,     0,     0,     0,     0,    51,     0,     0,    25,    28,
+      42,    29,     0,    48,    23,     0,     0,    63,    58,    59,
+      60,    61,    62,     0,     0,     0,    64,    16,     0,    14,
+      10,    43,    26,    44,    46,    47,     0,    54,     0,     0,
+      49,     0,     0,     0,     0,     0,    52,    35,    36,    30,
+      18,    22,    79,    80,     0,     0,     0,     0,     0,     0,
+       0,     0,     0,     0,     0,     0,     0,     0,     0,    45,
+       0,    55,    56,     0,     0,    50,     0,     0,    31,    32,
+      33,    34,    65,    68,    69,    72,    73,    67,    66,    70,
+      71,    74,    75,    76,    77,    78,    17,    53,     0,     0,
+       0,    51,     0,    57,     0,    37,    39,     0,     0,     0,
+      49,     0,    38,     0,     0,     0,     0,    40,     0,    41
 };
 
 /* YYPGOTO[NTERM-NUM].  */
-static const yytype_int8 yypgoto[] =
+static const yytype_int16 yypgoto[] =
 {
-     -19,   -19,    38,   -19,   -19,   -16,    12,   -19,   -19,   -19,
-     -19,   -18
+     -88,   -88,   -88,   170,   178,   176,   -88,   185,   -88,   167,
+      -4,   -88,   -87,   -78,    91,    98,   -20,   -88,   -88,   -21
 };
 
 /* YYDEFGOTO[NTERM-NUM].  */
 static const yytype_int8 yydefgoto[] =
 {
-       0,     3,     4,     5,     9,    28,    32,    33,    34,    35,
-      36,    19
+       0,     1,     2,     8,    17,    18,     9,    24,    25,    26,
+      50,    21,    51,    52,   116,    85,    66,   110,   111,    86
 };
 
 /* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
    positive, shift that token.  If negative, reduce the rule whose
    number is the opposite.  If YYTABLE_NINF, syntax error.  */
-static const yytype_int8 yytable[] =
+static const yytype_int16 yytable[] =
 {
-      21,     1,     6,    -5,    26,    14,    15,    16,    17,     8,
-       2,    22,    38,     2,    18,    29,    22,    25,    30,    42,
-      31,    44,    45,    22,     7,    22,    23,    22,    43,    47,
-      46,    13,    49,    11,    12,    24,    20,    22,    37,    27,
-      39,    48,    40,    10,     0,    41
+      13,    53,   115,   144,     3,    36,    19,    67,    14,    20,
+      38,    27,    39,    40,    41,    42,    43,    44,    45,    46,
+      47,    82,    83,    35,    32,    36,    37,   105,   106,   107,
+      38,    73,    39,    40,    41,    42,    43,    44,    45,    46,
+      47,     7,    92,    93,    94,    -2,     4,    33,     5,     6,
+      12,    90,   145,   146,    54,   109,   112,   113,   114,    55,
+      53,    71,   152,    28,     7,    48,    78,    12,   157,    56,
+      12,   159,   115,    79,   123,   124,   125,   126,   127,   128,
+     129,   130,   131,   132,   133,   134,   135,    74,    75,    80,
+      15,    57,    16,    58,    59,    60,    30,    70,    31,    31,
+      10,    11,    76,    77,   136,    15,    12,    33,    61,    62,
+      71,    72,    22,    23,    28,    29,    12,   143,    81,    53,
+      53,   148,    84,    63,    87,    88,    89,    64,    12,    53,
+      53,    77,    36,   156,    65,    53,   117,   108,    53,   120,
+      73,    95,    96,    97,    98,    99,   100,   121,   137,   101,
+     102,   103,   104,   105,   106,   107,   138,   141,   149,   142,
+      95,    96,    97,    98,    99,   100,   150,   151,   101,   102,
+     103,   104,   105,   106,   107,   154,    95,    96,    97,    98,
+      99,   100,   155,   122,   101,   102,   103,   104,   105,   106,
+     107,    49,    95,    96,    97,    98,    99,   100,    34,   139,
+     101,   102,   103,   104,   105,   106,   107,    69,    95,    96,
+      97,    98,    99,   100,    68,   140,   101,   102,   103,   104,
+     105,   106,   107,    91,    95,    96,    97,    98,    99,   100,
+       0,   158,   101,   102,   103,   104,   105,   106,   107,   147,
+       0,   153,   118,    95,    96,    97,    98,    99,   100,     0,
+       0,   101,   102,   103,   104,   105,   106,   107,     0,     0,
+       0,   119,    95,    96,    97,    98,    99,   100,     0,     0,
+     101,   102,   103,   104,   105,   106,   107,    95,    96,    97,
+      98,    99,     0,     0,     0,   101,   102,   103,   104,   105,
+     106,   107,    95,    96,    97,    98,     0,     0,     0,     0,
+     101,   102,   103,   104,   105,   106,   107,    97,    98,     0,
+       0,     0,     0,   101,   102,   103,   104,   105,   106,   107,
+     103,   104,   105,   106,   107
 };
 
-static const yytype_int8 yycheck[] =
+static const yytype_int16 yycheck[] =
 {
-      18,     1,    10,     3,    22,    10,    11,    12,    13,     3,
-      10,    14,    30,    10,    19,     5,    14,    20,     8,    37,
-      10,    39,    20,    14,     0,    14,    17,    14,    17,    45,
-      17,     4,    48,    17,    18,    20,    19,    14,    19,    21,
-      18,     6,    22,     5,    -1,    33
+       4,    21,    80,     1,     0,     3,     1,    28,    46,     4,
+       8,    42,    10,    11,    12,    13,    14,    15,    16,    17,
+      18,    42,    43,     1,    42,     3,     4,    36,    37,    38,
+       8,    35,    10,    11,    12,    13,    14,    15,    16,    17,
+      18,    19,    63,    64,    65,     0,     1,     3,     3,     4,
+      48,    55,   139,   140,     3,    76,    77,    78,    79,    47,
+      80,    42,   149,    45,    19,    43,    46,    48,   155,    44,
+      48,   158,   150,    46,    95,    96,    97,    98,    99,   100,
+     101,   102,   103,   104,   105,   106,   107,    30,    31,    46,
+       1,     3,     3,     5,     6,     7,    42,    42,    44,    44,
+      42,    43,    45,    46,   108,     1,    48,     3,    20,    21,
+      42,    43,     3,     4,    45,    46,    48,   138,    46,   139,
+     140,   142,     3,    35,    42,    42,    42,    39,    48,   149,
+     150,    46,     3,   154,    46,   155,     3,    47,   158,    42,
+     144,    24,    25,    26,    27,    28,    29,    42,    47,    32,
+      33,    34,    35,    36,    37,    38,    44,    42,     9,    49,
+      24,    25,    26,    27,    28,    29,    42,    50,    32,    33,
+      34,    35,    36,    37,    38,    50,    24,    25,    26,    27,
+      28,    29,    47,    47,    32,    33,    34,    35,    36,    37,
+      38,    21,    24,    25,    26,    27,    28,    29,    20,    47,
+      32,    33,    34,    35,    36,    37,    38,    31,    24,    25,
+      26,    27,    28,    29,    29,    47,    32,    33,    34,    35,
+      36,    37,    38,    56,    24,    25,    26,    27,    28,    29,
+      -1,    47,    32,    33,    34,    35,    36,    37,    38,   141,
+      -1,   150,    42,    24,    25,    26,    27,    28,    29,    -1,
+      -1,    32,    33,    34,    35,    36,    37,    38,    -1,    -1,
+      -1,    42,    24,    25,    26,    27,    28,    29,    -1,    -1,
+      32,    33,    34,    35,    36,    37,    38,    24,    25,    26,
+      27,    28,    -1,    -1,    -1,    32,    33,    34,    35,    36,
+      37,    38,    24,    25,    26,    27,    -1,    -1,    -1,    -1,
+      32,    33,    34,    35,    36,    37,    38,    26,    27,    -1,
+      -1,    -1,    -1,    32,    33,    34,    35,    36,    37,    38,
+      34,    35,    36,    37,    38
 };
 
 /* YYSTOS[STATE-NUM] -- The symbol kind of the accessing symbol of
    state STATE-NUM.  */
 static const yytype_int8 yystos[] =
 {
-       0,     1,    10,    24,    25,    26,    10,     0,     3,    27,
-      25,    17,    18,     4,    10,    11,    12,    13,    19,    34,
-      19,    34,    14,    17,    20,    20,    34,    21,    28,     5,
-       8,    10,    29,    30,    31,    32,    33,    19,    34,    18,
-      22,    29,    34,    17,    34,    20,    17,    28,     6,    28
+       0,    52,    53,     0,     1,     3,     4,    19,    54,    57,
+      42,    43,    48,    61,    46,     1,     3,    55,    56,     1,
+       4,    62,     3,     4,    58,    59,    60,    42,    45,    46,
+      42,    44,    42,     3,    55,     1,     3,     4,     8,    10,
+      11,    12,    13,    14,    15,    16,    17,    18,    43,    54,
+      61,    63,    64,    67,     3,    47,    44,     3,     5,     6,
+       7,    20,    21,    35,    39,    46,    67,    70,    58,    56,
+      42,    42,    43,    61,    30,    31,    45,    46,    46,    46,
+      46,    46,    70,    70,     3,    66,    70,    42,    42,    42,
+      61,    60,    70,    70,    70,    24,    25,    26,    27,    28,
+      29,    32,    33,    34,    35,    36,    37,    38,    47,    70,
+      68,    69,    70,    70,    70,    64,    65,     3,    42,    42,
+      42,    42,    47,    70,    70,    70,    70,    70,    70,    70,
+      70,    70,    70,    70,    70,    70,    61,    47,    44,    47,
+      47,    42,    49,    70,     1,    63,    63,    66,    70,     9,
+      42,    50,    63,    65,    50,    47,    70,    63,    47,    63
 };
 
 /* YYR1[RULE-NUM] -- Symbol kind of the left-hand side of rule RULE-NUM.  */
 static const yytype_int8 yyr1[] =
 {
-       0,    23,    24,    24,    25,    25,    26,    26,    27,    28,
-      29,    29,    30,    30,    30,    31,    32,    33,    33,    34,
-      34,    34,    34,    34,    34
+       0,    51,    52,    53,    53,    53,    53,    53,    53,    54,
+      54,    54,    54,    55,    55,    56,    56,    57,    57,    58,
+      58,    59,    59,    60,    60,    61,    61,    62,    62,    62,
+      63,    63,    63,    63,    63,    63,    63,    63,    63,    63,
+      63,    63,    63,    63,    63,    64,    64,    64,    64,    65,
+      65,    66,    66,    67,    68,    68,    69,    69,    70,    70,
+      70,    70,    70,    70,    70,    70,    70,    70,    70,    70,
+      70,    70,    70,    70,    70,    70,    70,    70,    70,    70,
+      70
 };
 
 /* YYR2[RULE-NUM] -- Number of symbols on the right-hand side of rule RULE-NUM.  */
 static const yytype_int8 yyr2[] =
 {
-       0,     2,     2,     1,     2,     0,     3,     5,     5,     3,
-       2,     0,     1,     1,     1,     4,     3,     5,     7,     1,
-       1,     1,     1,     3,     3
+       0,     2,     1,     0,     2,     2,     3,     3,     3,     3,
+       4,     3,     3,     1,     3,     1,     3,     6,     5,     0,
+       1,     1,     3,     2,     1,     3,     4,     0,     2,     2,
+       2,     3,     3,     3,     3,     2,     2,     5,     7,     5,
+       9,    10,     1,     2,     2,     3,     2,     2,     1,     0,
+       1,     0,     1,     4,     0,     1,     1,     3,     1,     1,
+       1,     1,     1,     1,     1,     3,     3,     3,     3,     3,
+       3,     3,     3,     3,     3,     3,     3,     3,     3,     2,
+       2
 };
 
 
@@ -938,13 +1234,6 @@ yydestruct (const char *yymsg,
 }
 
 
-/* Lookahead token kind.  */
-int yychar;
-
-/* The semantic value of the lookahead symbol.  */
-YYSTYPE yylval;
-/* Number of syntax errors so far.  */
-int yynerrs;
 
 
 
@@ -956,6 +1245,19 @@ int yynerrs;
 int
 yyparse (void)
 {
+/* Lookahead token kind.  */
+int yychar;
+
+
+/* The semantic value of the lookahead symbol.  */
+/* Default value used for initialization, for pacifying older GCCs
+   or non-GCC compilers.  */
+YY_INITIAL_VALUE (static YYSTYPE yyval_default;)
+YYSTYPE yylval YY_INITIAL_VALUE (= yyval_default);
+
+    /* Number of syntax errors so far.  */
+    int yynerrs = 0;
+
     yy_state_fast_t yystate = 0;
     /* Number of tokens to shift before error messages enabled.  */
     int yyerrstatus = 0;
@@ -1108,7 +1410,7 @@ yybackup:
   if (yychar == YYEMPTY)
     {
       YYDPRINTF ((stderr, "Reading a token\n"));
-      yychar = yylex ();
+      yychar = yylex (&yylval);
     }
 
   if (yychar <= YYEOF)
@@ -1195,14 +1497,496 @@ yyreduce:
   YY_REDUCE_PRINT (yyn);
   switch (yyn)
     {
-  case 3: /* program: error  */
-#line 28 "parser.y"
-            { yyerror("Syntax error in program"); }
-#line 1202 "y.tab.c"
+  case 2: /* program: items  */
+#line 161 "parser.y"
+          { program = (yyvsp[0].list).head; }
+#line 1504 "y.tab.c"
+    break;
+
+  case 3: /* items: %empty  */
+#line 165 "parser.y"
+                { (yyval.list) = list_one(NULL); decls = 0; }
+#line 1510 "y.tab.c"
+    break;
+
+  case 4: /* items: items declaration  */
+#line 166 "parser.y"
+                        { (yyval.list) = list_cat((yyvsp[-1].list), (yyvsp[0].list)); decls = 0; }
+#line 1516 "y.tab.c"
+    break;
+
+  case 5: /* items: items function  */
+#line 167 "parser.y"
+                     { (yyval.list) = list_add((yyvsp[-1].list), (yyvsp[0].node)); decls = 0; }
+#line 1522 "y.tab.c"
+    break;
+
+  case 6: /* items: items error ';'  */
+#line 168 "parser.y"
+                      { RECOVER; decls = 0; }
+#line 1528 "y.tab.c"
+    break;
+
+  case 7: /* items: items error '}'  */
+#line 169 "parser.y"
+                      { RECOVER; decls = 0; }
+#line 1534 "y.tab.c"
+    break;
+
+  case 8: /* items: items error block  */
+#line 170 "parser.y"
+                        { RECOVER; decls = 0; }
+#line 1540 "y.tab.c"
+    break;
+
+  case 9: /* declaration: TYPE init_list ';'  */
+#line 174 "parser.y"
+                       { (yyval.list) = typed((yyvsp[-1].list), (yyvsp[-2].type), 0); }
+#line 1546 "y.tab.c"
+    break;
+
+  case 10: /* declaration: CONST TYPE init_list ';'  */
+#line 175 "parser.y"
+                               { (yyval.list) = typed((yyvsp[-1].list), (yyvsp[-2].type), F_CONST); }
+#line 1552 "y.tab.c"
+    break;
+
+  case 11: /* declaration: TYPE error ';'  */
+#line 176 "parser.y"
+                     { RECOVER; (yyval.list) = list_one(NULL); }
+#line 1558 "y.tab.c"
+    break;
+
+  case 12: /* declaration: CONST error ';'  */
+#line 177 "parser.y"
+                      { RECOVER; (yyval.list) = list_one(NULL); }
+#line 1564 "y.tab.c"
+    break;
+
+  case 13: /* init_list: init  */
+#line 181 "parser.y"
+         { (yyval.list) = list_one((yyvsp[0].node)); }
+#line 1570 "y.tab.c"
+    break;
+
+  case 14: /* init_list: init_list ',' init  */
+#line 182 "parser.y"
+                         { (yyval.list) = list_add((yyvsp[-2].list), (yyvsp[0].node)); }
+#line 1576 "y.tab.c"
+    break;
+
+  case 15: /* init: ID  */
+#line 186 "parser.y"
+       { (yyval.node) = node_sym(N_VAR, (yyvsp[0].sym), tokline); decls++; }
+#line 1582 "y.tab.c"
+    break;
+
+  case 16: /* init: ID '=' expression  */
+#line 187 "parser.y"
+                        {
+        (yyval.node) = node_sym(N_VAR, (yyvsp[-2].sym), tokline);
+        if ((yyval.node)) (yyval.node)->a = (yyvsp[0].node);
+        decls++;
+    }
+#line 1592 "y.tab.c"
+    break;
+
+  case 17: /* function: TYPE ID '(' params ')' block  */
+#line 195 "parser.y"
+                                 {
+        (yyval.node) = node_sym(N_FUNC, (yyvsp[-4].sym), tokline);
+        if ((yyval.node)) { (yyval.node)->op = (yyvsp[-5].type); (yyval.node)->a = (yyvsp[-2].list).head; (yyval.node)->b = (yyvsp[0].node); (yyval.node)->v.i = decls; }
+    }
+#line 1601 "y.tab.c"
+    break;
+
+  case 18: /* function: ID '(' params ')' block  */
+#line 199 "parser.y"
+                              {
+        (yyval.node) = node_sym(N_FUNC, (yyvsp[-4].sym), tokline);
+        if ((yyval.node)) { (yyval.node)->op = TY_VOID; (yyval.node)->a = (yyvsp[-2].list).head; (yyval.node)->b = (yyvsp[0].node); (yyval.node)->v.i = decls; }
+    }
+#line 1610 "y.tab.c"
+    break;
+
+  case 19: /* params: %empty  */
+#line 206 "parser.y"
+                { (yyval.list) = list_one(NULL); }
+#line 1616 "y.tab.c"
+    break;
+
+  case 21: /* param_list: param  */
+#line 211 "parser.y"
+          { (yyval.list) = list_one((yyvsp[0].node)); }
+#line 1622 "y.tab.c"
+    break;
+
+  case 22: /* param_list: param_list ',' param  */
+#line 212 "parser.y"
+                           { (yyval.list) = list_add((yyvsp[-2].list), (yyvsp[0].node)); }
+#line 1628 "y.tab.c"
+    break;
+
+  case 23: /* param: TYPE ID  */
+#line 216 "parser.y"
+            {
+        (yyval.node) = node_sym(N_PARAM, (yyvsp[0].sym), tokline);
+        if ((yyval.node)) (yyval.node)->op = (yyvsp[-1].type);
+        decls++;
+    }
+#line 1638 "y.tab.c"
+    break;
+
+  case 24: /* param: ID  */
+#line 221 "parser.y"
+         {
+        (yyval.node) = node_sym(N_PARAM, (yyvsp[0].sym), tokline);
+        if ((yyval.node)) (yyval.node)->op = TY_INT;
+        decls++;
+    }
+#line 1648 "y.tab.c"
+    break;
+
+  case 25: /* block: '{' stmts '}'  */
+#line 229 "parser.y"
+                  { (yyval.node) = node_op(N_BLOCK, 0, (yyvsp[-1].list).head, NULL, tokline); }
+#line 1654 "y.tab.c"
+    break;
+
+  case 26: /* block: '{' stmts error '}'  */
+#line 230 "parser.y"
+                          {
+        RECOVER;
+        (yyval.node) = node_op(N_BLOCK, 0, (yyvsp[-2].list).head, NULL, tokline);
+    }
+#line 1663 "y.tab.c"
+    break;
+
+  case 27: /* stmts: %empty  */
+#line 237 "parser.y"
+                { (yyval.list) = list_one(NULL); }
+#line 1669 "y.tab.c"
+    break;
+
+  case 28: /* stmts: stmts declaration  */
+#line 238 "parser.y"
+                        { (yyval.list) = list_cat((yyvsp[-1].list), (yyvsp[0].list)); }
+#line 1675 "y.tab.c"
+    break;
+
+  case 29: /* stmts: stmts stmt  */
+#line 239 "parser.y"
+                 { (yyval.list) = list_add((yyvsp[-1].list), (yyvsp[0].node)); }
+#line 1681 "y.tab.c"
+    break;
+
+  case 31: /* stmt: PRINT expression ';'  */
+#line 244 "parser.y"
+                           { (yyval.node) = node_op(N_PRINT, PRINT, (yyvsp[-1].node), NULL, tokline); }
+#line 1687 "y.tab.c"
+    break;
+
+  case 32: /* stmt: PRINTLN expression ';'  */
+#line 245 "parser.y"
+                             { (yyval.node) = node_op(N_PRINT, PRINTLN, (yyvsp[-1].node), NULL, tokline); }
+#line 1693 "y.tab.c"
+    break;
+
+  case 33: /* stmt: READ ID ';'  */
+#line 246 "parser.y"
+                  { (yyval.node) = node_sym(N_READ, (yyvsp[-1].sym), tokline); }
+#line 1699 "y.tab.c"
+    break;
+
+  case 34: /* stmt: RETURN opt_expr ';'  */
+#line 247 "parser.y"
+                          { (yyval.node) = node_op(N_RETURN, 0, (yyvsp[-1].node), NULL, tokline); }
+#line 1705 "y.tab.c"
     break;
 
+  case 35: /* stmt: BREAK ';'  */
+#line 248 "parser.y"
+                { (yyval.node) = node(N_BREAK, tokline); }
+#line 1711 "y.tab.c"
+    break;
 
-#line 1206 "y.tab.c"
+  case 36: /* stmt: CONTINUE ';'  */
+#line 249 "parser.y"
+                   { (yyval.node) = node(N_CONTINUE, tokline); }
+#line 1717 "y.tab.c"
+    break;
+
+  case 37: /* stmt: IF '(' expression ')' stmt  */
+#line 250 "parser.y"
+                                                       {
+        (yyval.node) = node_op(N_IF, 0, (yyvsp[-2].node), (yyvsp[0].node), tokline);
+    }
+#line 1725 "y.tab.c"
+    break;
+
+  case 38: /* stmt: IF '(' expression ')' stmt ELSE stmt  */
+#line 253 "parser.y"
+                                           {
+        (yyval.node) = node_op(N_IF, 0, (yyvsp[-4].node), (yyvsp[-2].node), tokline);
+        if ((yyval.node)) (yyval.node)->c = (yyvsp[0].node);
+    }
+#line 1734 "y.tab.c"
+    break;
+
+  case 39: /* stmt: WHILE '(' expression ')' stmt  */
+#line 257 "parser.y"
+                                    { (yyval.node) = node_op(N_WHILE, 0, (yyvsp[-2].node), (yyvsp[0].node), tokline); }
+#line 1740 "y.tab.c"
+    break;
+
+  case 40: /* stmt: FOR '(' opt_simple ';' opt_expr ';' opt_simple ')' stmt  */
+#line 258 "parser.y"
+                                                              {
+        (yyval.node) = node_op(N_FOR, 0, (yyvsp[-6].node), (yyvsp[-4].node), tokline);
+        if ((yyval.node)) { (yyval.node)->c = (yyvsp[-2].node); (yyval.node)->d = (yyvsp[0].node); }
+    }
+#line 1749 "y.tab.c"
+    break;
+
+  case 41: /* stmt: FOREACH '(' ID ':' expression '.' '.' expression ')' stmt  */
+#line 262 "parser.y"
+                                                                {
+        (yyval.node) = node_op(N_FOREACH, 0, (yyvsp[-5].node), (yyvsp[-2].node), tokline);
+        if ((yyval.node)) { (yyval.node)->sym = (yyvsp[-7].sym); (yyval.node)->c = (yyvsp[0].node); }
+    }
+#line 1758 "y.tab.c"
+    break;
+
+  case 43: /* stmt: error ';'  */
+#line 267 "parser.y"
+                { RECOVER; (yyval.node) = NULL; }
+#line 1764 "y.tab.c"
+    break;
+
+  case 44: /* stmt: error block  */
+#line 268 "parser.y"
+                  { RECOVER; (yyval.node) = (yyvsp[0].node); }
+#line 1770 "y.tab.c"
+    break;
+
+  case 45: /* simple: ID '=' expression  */
+#line 272 "parser.y"
+                      {
+        (yyval.node) = node_op(N_ASSIGN, 0, (yyvsp[0].node), NULL, tokline);
+        if ((yyval.node)) (yyval.node)->sym = (yyvsp[-2].sym);
+    }
+#line 1779 "y.tab.c"
+    break;
+
+  case 46: /* simple: ID INC  */
+#line 276 "parser.y"
+             {
+        (yyval.node) = node_op(N_INCR, INC, NULL, NULL, tokline);
+        if ((yyval.node)) (yyval.node)->sym = (yyvsp[-1].sym);
+    }
+#line 1788 "y.tab.c"
+    break;
+
+  case 47: /* simple: ID DEC  */
+#line 280 "parser.y"
+             {
+        (yyval.node) = node_op(N_INCR, DEC, NULL, NULL, tokline);
+        if ((yyval.node)) (yyval.node)->sym = (yyvsp[-1].sym);
+    }
+#line 1797 "y.tab.c"
+    break;
+
+  case 48: /* simple: call  */
+#line 284 "parser.y"
+           { (yyval.node) = node_op(N_EXPR, 0, (yyvsp[0].node), NULL, tokline); }
+#line 1803 "y.tab.c"
+    break;
+
+  case 49: /* opt_simple: %empty  */
+#line 288 "parser.y"
+                { (yyval.node) = NULL; }
+#line 1809 "y.tab.c"
+    break;
+
+  case 51: /* opt_expr: %empty  */
+#line 293 "parser.y"
+                { (yyval.node) = NULL; }
+#line 1815 "y.tab.c"
+    break;
+
+  case 53: /* call: ID '(' args ')'  */
+#line 298 "parser.y"
+                    {
+        (yyval.node) = node_op(N_CALL, 0, (yyvsp[-1].list).head, NULL, tokline);
+        if ((yyval.node)) (yyval.node)->sym = (yyvsp[-3].sym);
+    }
+#line 1824 "y.tab.c"
+    break;
+
+  case 54: /* args: %empty  */
+#line 305 "parser.y"
+                { (yyval.list) = list_one(NULL); }
+#line 1830 "y.tab.c"
+    break;
+
+  case 56: /* arg_list: expression  */
+#line 310 "parser.y"
+               { (yyval.list) = list_one((yyvsp[0].node)); }
+#line 1836 "y.tab.c"
+    break;
+
+  case 57: /* arg_list: arg_list ',' expression  */
+#line 311 "parser.y"
+                              { (yyval.list) = list_add((yyvsp[-2].list), (yyvsp[0].node)); }
+#line 1842 "y.tab.c"
+    break;
+
+  case 58: /* expression: INT  */
+#line 315 "parser.y"
+        {
+        (yyval.node) = node(N_INT, tokline);
+        if ((yyval.node)) (yyval.node)->v.i = (yyvsp[0].ival);
+    }
+#line 1851 "y.tab.c"
+    break;
+
+  case 59: /* expression: REAL  */
+#line 319 "parser.y"
+           {
+        (yyval.node) = node(N_REAL, tokline);
+        if ((yyval.node)) (yyval.node)->v.r = (yyvsp[0].rval);
+    }
+#line 1860 "y.tab.c"
+    break;
+
+  case 60: /* expression: STRING  */
+#line 323 "parser.y"
+             {
+        (yyval.node) = node(N_STRING, tokline);
+        if ((yyval.node)) (yyval.node)->v.s = (yyvsp[0].sval);
+    }
+#line 1869 "y.tab.c"
+    break;
+
+  case 61: /* expression: TRUE  */
+#line 327 "parser.y"
+           {
+        (yyval.node) = node(N_BOOL, tokline);
+        if ((yyval.node)) (yyval.node)->v.i = 1;
+    }
+#line 1878 "y.tab.c"
+    break;
+
+  case 62: /* expression: FALSE  */
+#line 331 "parser.y"
+            { (yyval.node) = node(N_BOOL, tokline); }
+#line 1884 "y.tab.c"
+    break;
+
+  case 63: /* expression: ID  */
+#line 332 "parser.y"
+         { (yyval.node) = node_sym(N_NAME, (yyvsp[0].sym), tokline); }
+#line 1890 "y.tab.c"
+    break;
+
+  case 65: /* expression: '(' expression ')'  */
+#line 334 "parser.y"
+                         { (yyval.node) = (yyvsp[-1].node); }
+#line 1896 "y.tab.c"
+    break;
+
+  case 66: /* expression: expression OR expression  */
+#line 335 "parser.y"
+                               { (yyval.node) = node_op(N_BINARY, OR, (yyvsp[-2].node), (yyvsp[0].node), tokline); }
+#line 1902 "y.tab.c"
+    break;
+
+  case 67: /* expression: expression AND expression  */
+#line 336 "parser.y"
+                                { (yyval.node) = node_op(N_BINARY, AND, (yyvsp[-2].node), (yyvsp[0].node), tokline); }
+#line 1908 "y.tab.c"
+    break;
+
+  case 68: /* expression: expression EQ expression  */
+#line 337 "parser.y"
+                               { (yyval.node) = node_op(N_BINARY, EQ, (yyvsp[-2].node), (yyvsp[0].node), tokline); }
+#line 1914 "y.tab.c"
+    break;
+
+  case 69: /* expression: expression NE expression  */
+#line 338 "parser.y"
+                               { (yyval.node) = node_op(N_BINARY, NE, (yyvsp[-2].node), (yyvsp[0].node), tokline); }
+#line 1920 "y.tab.c"
+    break;
+
+  case 70: /* expression: expression '<' expression  */
+#line 339 "parser.y"
+                                { (yyval.node) = node_op(N_BINARY, '<', (yyvsp[-2].node), (yyvsp[0].node), tokline); }
+#line 1926 "y.tab.c"
+    break;
+
+  case 71: /* expression: expression '>' expression  */
+#line 340 "parser.y"
+                                { (yyval.node) = node_op(N_BINARY, '>', (yyvsp[-2].node), (yyvsp[0].node), tokline); }
+#line 1932 "y.tab.c"
+    break;
+
+  case 72: /* expression: expression LE expression  */
+#line 341 "parser.y"
+                               { (yyval.node) = node_op(N_BINARY, LE, (yyvsp[-2].node), (yyvsp[0].node), tokline); }
+#line 1938 "y.tab.c"
+    break;
+
+  case 73: /* expression: expression GE expression  */
+#line 342 "parser.y"
+                               { (yyval.node) = node_op(N_BINARY, GE, (yyvsp[-2].node), (yyvsp[0].node), tokline); }
+#line 1944 "y.tab.c"
+    break;
+
+  case 74: /* expression: expression '+' expression  */
+#line 343 "parser.y"
+                                { (yyval.node) = node_op(N_BINARY, '+', (yyvsp[-2].node), (yyvsp[0].node), tokline); }
+#line 1950 "y.tab.c"
+    break;
+
+  case 75: /* expression: expression '-' expression  */
+#line 344 "parser.y"
+                                { (yyval.node) = node_op(N_BINARY, '-', (yyvsp[-2].node), (yyvsp[0].node), tokline); }
+#line 1956 "y.tab.c"
+    break;
+
+  case 76: /* expression: expression '*' expression  */
+#line 345 "parser.y"
+                                { (yyval.node) = node_op(N_BINARY, '*', (yyvsp[-2].node), (yyvsp[0].node), tokline); }
+#line 1962 "y.tab.c"
+    break;
+
+  case 77: /* expression: expression '/' expression  */
+#line 346 "parser.y"
+                                { (yyval.node) = node_op(N_BINARY, '/', (yyvsp[-2].node), (yyvsp[0].node), tokline); }
+#line 1968 "y.tab.c"
+    break;
+
+  case 78: /* expression: expression '%' expression  */
+#line 347 "parser.y"
+                                { (yyval.node) = node_op(N_BINARY, '%', (yyvsp[-2].node), (yyvsp[0].node), tokline); }
+#line 1974 "y.tab.c"
+    break;
+
+  case 79: /* expression: '-' expression  */
+#line 348 "parser.y"
+                                  { (yyval.node) = node_op(N_UNARY, '-', (yyvsp[0].node), NULL, tokline); }
+#line 1980 "y.tab.c"
+    break;
+
+  case 80: /* expression: '!' expression  */
+#line 349 "parser.y"
+                     { (yyval.node) = node_op(N_UNARY, '!', (yyvsp[0].node), NULL, tokline); }
+#line 1986 "y.tab.c"
+    break;
+
+
+#line 1990 "y.tab.c"
 
       default: break;
     }
@@ -1395,28 +2179,432 @@ yyreturnlab:
   return yyresult;
 }
 
-#line 82 "parser.y"
+#line 352 "parser.y"
+
+
+// Parser-side token hook: replays a token array or pulls from the scanner
+// --time-report scans ahead of the parser in batches, so the two can be
+// timed apart with a clock read per batch instead of two per token; a token
+// stream file is replayed the same way. --pipeline takes its batches from a
+// scanner thread instead.
+#define BATCH 4096
+static Token *batch;    // batch[0] keeps the last token of the batch before
+static int (*batch_next)(Token *t);     // scan_next or stream_next
+static _Thread_local int (*refill)(void);  // next batch into replay; NULL for an array
+
+static int refill_batch(void) {
+    batch[0] = replay[-1];
+    int n = 0;
+    PHASE_PUSH(PH_SCAN);
+    while (n < BATCH && batch_next(&batch[1 + n])) n++;
+    PHASE_POP();
+    // Short of a full batch, batch_next has put the end token after the last
+    if (n < BATCH) n++;
+    replay = batch + 1;
+    replay_end = replay + n;
+    return n;
+}
 
+// The last batch holds just the end token
+static int refill_pipe(void) {
+    int n;
+    replay = pipe_take(&n);
+    replay_end = replay + (n ? n : 1);
+    return 1;
+}
+
+// Symbol id for the trace; --check never interns names
+static int token_sym(int kind, const YYSTYPE *val) {
+    return kind == ID && !check_only ? val->sym : -1;
+}
+
+int yylex(YYSTYPE *lval) {
+    if (replay) {
+        while (replay == replay_end || replay->kind == TRIVIA) {
+            if (replay != replay_end) replay++;
+            else if (refill == NULL || !refill()) return 0;
+        }
+        *lval = replay->val;
+        // The scanner thread must not touch the tree arena, so string values
+        // are made here
+        if (defer_strings && replay->kind == STRING && !check_only)
+            lval->sval = string_value(replay_text + replay->off, replay->len);
+        tokline = replay->line;
+        if (trace && replay->kind != 0)
+            trace_token(replay->kind, replay->off, replay->len, token_sym(replay->kind, lval));
+        return (replay++)->kind;
+    }
+    int token = scan();
+    *lval = yylval;
+    tokline = linenum;
+    if (trace && token != 0)
+        trace_token(token, scan_offset - yyleng, yyleng, token_sym(token, lval));
+    return token;
+}
+
+// Parse the tokens next produces, fetched in batches ahead of the parser
+static int parse_batched(const char *text, int (*next)(Token *t)) {
+    static Token tokens[BATCH + 1];
+    batch = tokens;
+    batch_next = next;
+    refill = refill_batch;
+    replay_text = text;
+    replay_base = 0;
+    replay = replay_end = batch + 1;
+    int status = yyparse();
+    replay = NULL;
+    refill = NULL;
+    batch = NULL;
+    return status;
+}
+
+// Parse text while a second thread scans it; batched on this one if the
+// thread can't be started
+static int parse_piped(char *text, size_t len) {
+    static const Token none[1];
+    defer_strings = 1;
+    if (!pipe_start(text, len)) {
+        perror("pipeline");
+        defer_strings = 0;
+        scan_begin(text, len, SCAN_INITIAL, 1);
+        return parse_batched(text, scan_next);
+    }
+    refill = refill_pipe;
+    replay_text = text;
+    replay_base = 0;
+    replay = replay_end = none + 1;
+    int status = yyparse();
+    pipe_finish();
+    replay = NULL;
+    refill = NULL;
+    defer_strings = 0;
+    return status;
+}
+
+// Parse a pre-scanned token array; returns its top-level nodes
+Node *parse_tokens(const char *text, const Token *t, int n, int line_base, int *errs) {
+    int count = 0;
+    counted = &count;   // the error cap applies per token array
+    replay_text = text;
+    replay = t;
+    replay_end = t + n + 1;
+    replay_base = line_base;
+    program = NULL;
+    yyparse();
+    replay = NULL;
+    counted = &errors;
+    *errs = count;
+    __atomic_add_fetch(&errors, count, __ATOMIC_RELAXED);
+    return program;
+}
+
+#ifdef PROFILE
+static long reduce_hits[YYNRULES + 1];  // indexed by bison's rule number
+
+// Parsers run on several threads at once (--pipeline, --jobs)
+static void profile_reduce(int rule) {
+    __atomic_add_fetch(&reduce_hits[rule], 1, __ATOMIC_RELAXED);
+}
+
+static int by_hits(const void *a, const void *b) {
+    long x = reduce_hits[*(const int *)a], y = reduce_hits[*(const int *)b];
+    return (x < y) - (x > y);
+}
+
+// Rules by name of the nonterminal they reduce to and their line here
+void parse_profile(FILE *f) {
+    int order[YYNRULES];
+    long total = 0;
+    for (int r = 1; r <= YYNRULES; r++) {
+        order[r - 1] = r;
+        total += reduce_hits[r];
+    }
+    qsort(order, YYNRULES, sizeof(int), by_hits);
+    fprintf(f, "%-24s %12s %7s\n", "reduction", "hits", "share");
+    for (int i = 0; i < YYNRULES; i++) {
+        int r = order[i];
+        char name[64];
+        snprintf(name, sizeof(name), "%s:%d", yytname[yyr1[r]], yyrline[r]);
+        fprintf(f, "%-24s %12ld %6.2f%%\n", name, reduce_hits[r],
+                total ? 100.0 * reduce_hits[r] / total : 0);
+    }
+    fprintf(f, "%-24s %12ld\n", "total", total);
+}
+
+static void dump_profile(void) {
+    scan_profile(stderr);
+    fprintf(stderr, "\n");
+    parse_profile(stderr);
+}
+#endif
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static char *read_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *text = mem_alloc(*len + 2);
+    *len = fread(text, 1, *len, f);
+    text[*len] = text[*len + 1] = '\0';
+    fclose(f);
+    return text;
+}
+
+// Print the --time-report and --mem-report tables, if asked for, on the way
+// out, and flush the token trace
+static int finish(int status) {
+    if (trace && !trace_close()) {
+        perror("trace");
+        status = 1;
+    }
+    if (time_report) phase_report(stderr, time_report == 2);
+    if (mem_report) mem_stats(stderr, mem_report == 2);
+    return status;
+}
+
+// Error count on stderr; returns the exit status for a parse that returned
+// status
+static int summary(int status) {
+    if (errors > 0)
+        fprintf(stderr, "%d error%s\n", errors, errors == 1 ? "" : "s");
+    return status != 0 || errors != 0;
+}
+
+// Semantic passes, once there is a tree without syntax errors
+static void analyze(void) {
+    if (check_only || errors > 0 || program == NULL) return;
+    PHASE_PUSH(PH_SEMA);
+    analyze_program(program, sema_jobs);
+    if (unused) warn_unused();
+    PHASE_POP();
+}
+
+// --run: compile the program and execute it, once it has no errors;
+// returns the exit status
+static int execute(int status) {
+    if (!run || status != 0 || program == NULL) return status;
+    PHASE_PUSH(PH_COMPILE);
+    Program *p = compile(program);
+    PHASE_POP();
+    if (p == NULL) return summary(0);
+    PHASE_PUSH(PH_RUN);
+    status = vm_run(p);
+    PHASE_POP();
+    program_free(p);
+    return status;
+}
+
+// --edit OFF,DEL,TEXT: parse once, then apply each edit incrementally
+static int run_edits(const char *path, char **edits, int nedits) {
+    size_t len;
+    PHASE_PUSH(PH_OPEN);
+    char *text = read_file(path, &len);
+    PHASE_POP();
+    if (!text) {
+        perror("fopen");
+        return 1;
+    }
+    Doc doc;
+    double t0 = now_us();
+    doc_open(&doc, text, len);
+    printf("initial parse: %.1f us, %d items\n", now_us() - t0, doc.n);
+    mem_free(text);
+    for (int i = 0; i < nedits; i++) {
+        int off, del, pos;
+        if (sscanf(edits[i], "%d,%d,%n", &off, &del, &pos) != 2 ||
+            off < 0 || del < 0 || off + del > doc.len) {
+            fprintf(stderr, "Bad edit '%s'\n", edits[i]);
+            return 1;
+        }
+        const char *ins = edits[i] + pos;
+        t0 = now_us();
+        int reparsed = doc_edit(&doc, off, del, ins, strlen(ins));
+        printf("edit %d: %.1f us, %d of %d items reparsed\n",
+               i + 1, now_us() - t0, reparsed, doc.n);
+    }
+    int errs = doc_errors(&doc);
+    doc_close(&doc);
+    return errs != 0;
+}
 
 int main(int argc, char **argv) {
-    if (argc != 2) {
-        printf("Usage: %s <input file>\n", argv[0]);
+    const char *path = NULL, *trace_path = NULL, *emit_path = NULL, *cache_dir = NULL;
+    long cache_limit = 64L << 20;
+    char *edits[argc];
+    int nedits = 0;
+#ifdef PROFILE
+    atexit(dump_profile);
+#endif
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--check") == 0) check_only = 1;
+        else if (strcmp(argv[i], "--quiet") == 0) quiet = 1;
+        else if (strcmp(argv[i], "--scan-only") == 0) scan_only = 1;
+        else if (strcmp(argv[i], "--time-report") == 0) time_report = 1;
+        else if (strcmp(argv[i], "--time-report=json") == 0) time_report = 2;
+        else if (strcmp(argv[i], "--mem-report") == 0) mem_report = 1;
+        else if (strcmp(argv[i], "--mem-report=json") == 0) mem_report = 2;
+        else if (strcmp(argv[i], "--max-errors") == 0 && i + 1 < argc)
+            max_errors = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--stack-budget") == 0 && i + 1 < argc)
+            stack_budget = atol(argv[++i]);
+        else if (strcmp(argv[i], "--from-tokens") == 0) from_tokens = 1;
+        else if (strcmp(argv[i], "--pipeline") == 0) pipeline = 1;
+        else if (strcmp(argv[i], "--warn-unused") == 0) unused = 1;
+        else if (strcmp(argv[i], "--run") == 0) run = quiet = 1;
+        else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+            sema_jobs = jobs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--emit-tokens") == 0 && i + 1 < argc)
+            emit_path = argv[++i];
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+            cache_dir = argv[++i];
+        else if (strcmp(argv[i], "--cache-size") == 0 && i + 1 < argc)
+            cache_limit = atol(argv[++i]);
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            trace_path = argv[++i];
+        else if (strcmp(argv[i], "--edit") == 0 && i + 1 < argc)
+            edits[nedits++] = argv[++i];
+        else if (path == NULL) path = argv[i];
+        else {
+            path = NULL;
+            break;
+        }
+    }
+    if (path == NULL) {
+        printf("Usage: %s [--check | --quiet | --scan-only] [--max-errors N]\n"
+               "       [--stack-budget BYTES] [--time-report[=json]]\n"
+               "       [--mem-report[=json]] [--trace FILE] [--edit OFF,DEL,TEXT]...\n"
+               "       [--emit-tokens FILE | --from-tokens | --pipeline | --jobs N]\n"
+               "       [--cache DIR] [--cache-size BYTES] [--warn-unused] [--run]\n"
+               "       <input file>\n", argv[0]);
         return 1;
     }
 
-    yyin = fopen(argv[1], "r");
-    if (!yyin) {
-        perror("fopen");
+    listing = !check_only && !quiet && !scan_only && nedits == 0 && !emit_path && !from_tokens;
+    if (nedits > 0) return finish(run_edits(path, edits, nedits));
+    if (trace_path) {
+        if (!trace_open(trace_path)) {
+            perror(trace_path);
+            return 1;
+        }
+        trace = 1;
+    }
+
+    // --emit-tokens: scan only, saving the tokens for a later --from-tokens
+    if (emit_path) {
+        size_t len;
+        PHASE_PUSH(PH_OPEN);
+        char *text = read_file(path, &len);
+        PHASE_POP();
+        if (!text) {
+            perror("fopen");
+            return 1;
+        }
+        PHASE_PUSH(PH_SCAN);
+        long tokens = stream_write(emit_path, text, len);
+        PHASE_POP();
+        mem_free(text);
+        if (tokens < 0) {
+            perror(emit_path);
+            return 1;
+        }
+        printf("%ld tokens\n", tokens);
+        return finish(errors != 0);
+    }
+
+    if (scan_only) {
+        PHASE_PUSH(PH_OPEN);
+        yyin = fopen(path, "r");
+        PHASE_POP();
+        if (!yyin) {
+            perror("fopen");
+            return 1;
+        }
+        long tokens = 0;
+        PHASE_PUSH(PH_SCAN);
+        for (int t; (t = scan()) != 0; tokens++)
+            if (trace) trace_token(t, scan_offset - yyleng, yyleng, token_sym(t, &yylval));
+        PHASE_POP();
+        fclose(yyin);
+        printf("%ld tokens\n", tokens);
+        return finish(errors != 0);
+    }
+
+    // The parse cache only stands in for runs that print nothing but
+    // diagnostics, and a traced run has to see the tokens
+    if (listing || from_tokens || trace) cache_dir = NULL;
+    // Parts are scanned and parsed apart, so nothing may be echoed or traced
+    // in token order
+    if (listing || from_tokens || trace) jobs = 0;
+
+    // Reported, cached, pipelined and split runs read the whole input up front and
+    // scan it in batches, so scanning and parsing are charged apart;
+    // otherwise the scanner streams from the file as the parser asks
+    char *text = NULL;
+    size_t len;
+    int opened;
+    PHASE_PUSH(PH_OPEN);
+    if (from_tokens) opened = stream_open(path);
+    else if (time_report || mem_report || cache_dir || pipeline || jobs > 0)
+        opened = (text = read_file(path, &len)) != NULL;
+    else opened = (yyin = fopen(path, "r")) != NULL;
+    // flex reads whole buffers, so --check keeps no stdio buffer under its own
+    if (check_only && yyin) setvbuf(yyin, NULL, _IONBF, 0);
+    PHASE_POP();
+    if (!opened) {
+        if (!from_tokens) perror("fopen");
         return 1;
     }
 
-    printf("Starting parsing...\n");
+    if (!check_only && !quiet) printf("Starting parsing...\n");
+
+    // Everything that changes the result is part of the key
+    uint64_t key = 0;
+    int status;
+    if (cache_dir) {
+        long opts[] = { check_only, max_errors, stack_budget };
+        PHASE_PUSH(PH_CACHE);
+        key = cache_key(text, len, opts, sizeof(opts));
+        int hit = cache_load(cache_dir, key, &status);
+        PHASE_POP();
+        if (hit) {
+            mem_free(text);
+            analyze();
+            return finish(execute(summary(status)));
+        }
+        cache_record();
+    }
 
-    int token;
-    while ((token = yylex()) != 0) {
-        printf("Token: %d, Text: %s\n", token, yytext);
+    PHASE_PUSH(PH_PARSE);
+    if (from_tokens) {
+        status = parse_batched(NULL, stream_next);
+    } else if (jobs > 0) {
+        parse_parallel(text, len, jobs);
+        status = 0;
+    } else if (pipeline) {
+        status = parse_piped(text, len);
+    } else if (text) {
+        scan_begin(text, len, SCAN_INITIAL, 1);
+        status = parse_batched(text, scan_next);
+    } else {
+        status = yyparse();
     }
+    PHASE_POP();
 
-    fclose(yyin);
-    return 0;
+    if (cache_dir) {
+        PHASE_PUSH(PH_CACHE);
+        cache_store(cache_dir, key, status, cache_limit);
+        PHASE_POP();
+    }
+    if (from_tokens) stream_close();
+    else if (text) mem_free(text);
+    else fclose(yyin);
+    analyze();
+    return finish(execute(summary(status)));
 }
@@ -54,20 +54,37 @@ extern int yydebug;
     YYEOF = 0,                     /* "end of file"  */
     YYerror = 256,                 /* error  */
     YYUNDEF = 257,                 /* "invalid token"  */
-    VOID = 258,                    /* VOID  */
-    MAIN = 259,                    /* MAIN  */
-    IF = 260,                      /* IF  */
-    ELSE = 261,                    /* ELSE  */
-    WHILE = 262,                   /* WHILE  */
-    PRINT = 263,                   /* PRINT  */
-    RETURN = 264,                  /* RETURN  */
-    ID = 265,                      /* ID  */
-    INT = 266,                     /* INT  */
-    REAL = 267,                    /* REAL  */
-    STRING = 268,                  /* STRING  */
-    OP = 269,                      /* OP  */
-    DELIM = 270,                   /* DELIM  */
-    KEYWORD = 271                  /* KEYWORD  */
+    ID = 258,                      /* ID  */
+    TYPE = 259,                    /* TYPE  */
+    INT = 260,                     /* INT  */
+    REAL = 261,                    /* REAL  */
+    STRING = 262,                  /* STRING  */
+    IF = 263,                      /* IF  */
+    ELSE = 264,                    /* ELSE  */
+    WHILE = 265,                   /* WHILE  */
+    FOR = 266,                     /* FOR  */
+    FOREACH = 267,                 /* FOREACH  */
+    PRINT = 268,                   /* PRINT  */
+    PRINTLN = 269,                 /* PRINTLN  */
+    READ = 270,                    /* READ  */
+    RETURN = 271,                  /* RETURN  */
+    BREAK = 272,                   /* BREAK  */
+    CONTINUE = 273,                /* CONTINUE  */
+    CONST = 274,                   /* CONST  */
+    TRUE = 275,                    /* TRUE  */
+    FALSE = 276,                   /* FALSE  */
+    KEYWORD = 277,                 /* KEYWORD  */
+    TRIVIA = 278,                  /* TRIVIA  */
+    EQ = 279,                      /* EQ  */
+    NE = 280,                      /* NE  */
+    LE = 281,                      /* LE  */
+    GE = 282,                      /* GE  */
+    AND = 283,                     /* AND  */
+    OR = 284,                      /* OR  */
+    INC = 285,                     /* INC  */
+    DEC = 286,                     /* DEC  */
+    UMINUS = 287,                  /* UMINUS  */
+    LOWER_THAN_ELSE = 288          /* LOWER_THAN_ELSE  */
   };
   typedef enum yytokentype yytoken_kind_t;
 #endif
@@ -76,30 +93,61 @@ extern int yydebug;
 #define YYEOF 0
 #define YYerror 256
 #define YYUNDEF 257
-#define VOID 258
-#define MAIN 259
-#define IF 260
-#define ELSE 261
-#define WHILE 262
-#define PRINT 263
-#define RETURN 264
-#define ID 265
-#define INT 266
-#define REAL 267
-#define STRING 268
-#define OP 269
-#define DELIM 270
-#define KEYWORD 271
+#define ID 258
+#define TYPE 259
+#define INT 260
+#define REAL 261
+#define STRING 262
+#define IF 263
+#define ELSE 264
+#define WHILE 265
+#define FOR 266
+#define FOREACH 267
+#define PRINT 268
+#define PRINTLN 269
+#define READ 270
+#define RETURN 271
+#define BREAK 272
+#define CONTINUE 273
+#define CONST 274
+#define TRUE 275
+#define FALSE 276
+#define KEYWORD 277
+#define TRIVIA 278
+#define EQ 279
+#define NE 280
+#define LE 281
+#define GE 282
+#define AND 283
+#define OR 284
+#define INC 285
+#define DEC 286
+#define UMINUS 287
+#define LOWER_THAN_ELSE 288
 
 /* Value type.  */
 #if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
-typedef int YYSTYPE;
+union YYSTYPE
+{
+#line 121 "parser.y"
+
+    long long ival;
+    double rval;
+    char *sval;
+    int sym;
+    int type;
+    Node *node;
+    List list;
+
+#line 143 "y.tab.h"
+
+};
+typedef union YYSTYPE YYSTYPE;
 # define YYSTYPE_IS_TRIVIAL 1
 # define YYSTYPE_IS_DECLARED 1
 #endif
 
 
-extern YYSTYPE yylval;
 
 
 int yyparse (void);